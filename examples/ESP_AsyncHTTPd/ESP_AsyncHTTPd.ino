@@ -89,7 +89,7 @@ void setup() {
     }
 
     request.enumQueries([&](AsyncWebQuery const& q){
-      Serial.printf("_QUERY[%s]: %s\n", q.name.c_str(), q.value.c_str());
+      Serial.printf("_QUERY[%s]: %s\n", q.name, q.value);
       return false;
     });
 
@@ -1,59 +1,144 @@
 
 #include "AsyncJsonResponse.h"
 
-class BufferWindowPrint : public Print {
+// Fills a chunk, and keeps whatever does not fit for the next one
+class JsonChunkPrint : public Print {
 	private:
 		uint8_t* _buf;
-		size_t _win_start;
-		size_t _win_size;
-		size_t _prn_pos;
+		size_t _len;
+		size_t _pos;
+		String &_carry;
 	public:
-		BufferWindowPrint(uint8_t* buf, size_t len, size_t offset)
-			: _buf(buf), _win_start(offset), _win_size(len), _prn_pos{0}
+		JsonChunkPrint(uint8_t* buf, size_t len, String &carry)
+			: _buf(buf), _len(len), _pos(0), _carry(carry)
 			{}
 
 		virtual size_t write(uint8_t c) override {
-			if (_win_start) {
-				--_win_start;
-				return 1;
-			}
-			if (_prn_pos < _win_size) {
-				_buf[_prn_pos++] = c;
-				return 1;
-			}
-			return 0;
+			return write(&c, 1);
 		}
 
 		virtual size_t write(const uint8_t *buffer, size_t size) override {
-			if (_win_start >= size) {
-				_win_start -= size;
-				return size;
-			}
-			if (_prn_pos < _win_size) {
-				size_t bufofs = _win_start;
-				if (bufofs) {
-					buffer += _win_start;
-					size -= _win_start;
-					_win_start = 0;
-				}
-				size_t wlen = min(size, _win_size - _prn_pos);
-				memcpy(_buf+_prn_pos, buffer, wlen);
-				_prn_pos += wlen;
-				return wlen+bufofs;
-			}
-			return 0;
+			size_t wlen = min(size, _len - _pos);
+			memcpy(_buf+_pos, buffer, wlen);
+			_pos += wlen;
+			if (wlen < size) _carry.concat((char const*)buffer+wlen, size-wlen);
+			return size;
 		}
 
-		size_t printed_length() { return _prn_pos; }
+		bool full() const { return _pos == _len; }
+		size_t printed_length() const { return _pos; }
 };
 
+void AsyncJsonResponse::_printIndent(JsonChunkPrint &out, uint8_t depth) {
+	// Same layout as prettyPrintTo()
+	out.write((uint8_t const*)"\r\n", 2);
+	while (depth--) out.write((uint8_t const*)"  ", 2);
+}
+
+void AsyncJsonResponse::_printValue(JsonChunkPrint &out, JsonVariant const &value) {
+	bool isObject = value.is<JsonObject>();
+	if (!isObject && !value.is<JsonArray>()) {
+		value.printTo(out);
+		return;
+	}
+
+	if (_depth == _stackSize) {
+		uint8_t newSize = _stackSize? _stackSize * 2 : 4;
+		PrintFrame *stack = newSize > _stackSize?
+			(PrintFrame*)realloc(_stack, newSize * sizeof(PrintFrame)) : nullptr;
+		if (!stack) {
+			// Part of the document may be out already, dropping the connection
+			//   is the only way left to tell the client it is incomplete
+			ESPWS_LOG("[%s] ERROR: Json document nested too deep to print, aborting response\n",
+				_request->_remoteIdent.c_str());
+			_printDone = true;
+			_state = RESPONSE_FAILED;
+			return;
+		}
+		_stack = stack;
+		_stackSize = newSize;
+	}
+	PrintFrame &frame = _stack[_depth];
+	frame.isObject = isObject;
+	frame.first = true;
+	if (isObject) {
+		JsonObject &obj = value.as<JsonObject>();
+		frame.objIt = obj.begin();
+		frame.objEnd = obj.end();
+		if (frame.objIt == frame.objEnd) {
+			out.write((uint8_t const*)"{}", 2);
+			return;
+		}
+		out.write('{');
+	} else {
+		JsonArray &arr = value.as<JsonArray>();
+		frame.arrIt = arr.begin();
+		frame.arrEnd = arr.end();
+		if (frame.arrIt == frame.arrEnd) {
+			out.write((uint8_t const*)"[]", 2);
+			return;
+		}
+		out.write('[');
+	}
+	_depth++;
+}
+
+void AsyncJsonResponse::_printStep(JsonChunkPrint &out) {
+	if (!_printStarted) {
+		_printStarted = true;
+		_printValue(out, _jsonRoot);
+		return;
+	}
+	if (!_depth) {
+		_printDone = true;
+		return;
+	}
+
+	PrintFrame &frame = _stack[_depth-1];
+	if (frame.isObject? frame.objIt == frame.objEnd : frame.arrIt == frame.arrEnd) {
+		_depth--;
+		if (_prettyPrint) _printIndent(out, _depth);
+		out.write(frame.isObject? '}' : ']');
+		return;
+	}
+	if (!frame.first) out.write(',');
+	frame.first = false;
+	if (_prettyPrint) _printIndent(out, _depth);
+
+	// Advance before descending, the frame may move when the stack grows
+	JsonVariant value;
+	if (frame.isObject) {
+		JsonPair &pair = *frame.objIt;
+		++frame.objIt;
+		JsonVariant(pair.key).printTo(out);
+		if (_prettyPrint) out.write((uint8_t const*)": ", 2);
+		else out.write(':');
+		value = pair.value;
+	} else {
+		value = *frame.arrIt;
+		++frame.arrIt;
+	}
+	_printValue(out, value);
+}
+
 size_t AsyncJsonResponse::_JsonFiller(uint8_t* buf, size_t len, size_t offset) {
-	BufferWindowPrint WinBuf(buf, len, offset);
-	if (_prettyPrint) _jsonRoot.prettyPrintTo(WinBuf);
-	else _jsonRoot.printTo(WinBuf);
+	size_t outLen = 0;
+	if (_carryOfs < _carry.length()) {
+		outLen = min(len, _carry.length() - _carryOfs);
+		memcpy(buf, _carry.begin() + _carryOfs, outLen);
+		_carryOfs += outLen;
+		if (_carryOfs < _carry.length()) return outLen;
+	}
+	// Capacity is kept for the next overflow
+	_carry.clear();
+	_carryOfs = 0;
+
+	JsonChunkPrint ChunkBuf(buf + outLen, len - outLen, _carry);
+	while (!ChunkBuf.full() && !_printDone) _printStep(ChunkBuf);
+	outLen += ChunkBuf.printed_length();
 	ESPWS_DEBUGVV("[%s] Json buffer fill @%d, len %d, got %d\n",
-		_request->_remoteIdent.c_str(), offset, len, WinBuf.printed_length());
-	return WinBuf.printed_length();
+		_request->_remoteIdent.c_str(), offset, len, outLen);
+	return outLen;
 }
 
 void AsyncJsonResponse::setPrettyPrint(bool enable) {
@@ -63,3 +148,292 @@ void AsyncJsonResponse::setPrettyPrint(bool enable) {
 	}
 	_prettyPrint = enable;
 }
+
+void AsyncJsonResponse::setSizedResponse(bool enable) {
+	if (_started()) {
+		ESPWS_LOG("[%s] ERROR: Response already started, cannot change sizing!\n");
+		return;
+	}
+	_sized = enable;
+}
+
+void AsyncJsonResponse::_assembleHead(void) {
+	if (!_sized) {
+		AsyncChunkedResponse::_assembleHead();
+		return;
+	}
+	// One extra pass over the tree, but no chunk framing and works for HTTP/1.0
+	_contentLength = _prettyPrint? _jsonRoot.measurePrettyLength()
+		: _jsonRoot.measureLength();
+	AsyncBasicResponse::_assembleHead();
+}
+
+void AsyncJsonResponse::_prepareContentSendBuf(size_t space) {
+	if (!_sized) AsyncChunkedResponse::_prepareContentSendBuf(space);
+	else AsyncBufferedResponse::_prepareContentSendBuf(space);
+}
+
+size_t AsyncJsonResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
+	if (!_sized) return AsyncChunkedResponse::_fillBuffer(buf, maxLen);
+
+	size_t outLen = _JsonFiller(buf, maxLen, _bufPrepared);
+	if (_failed()) return 0;
+	if (outLen < maxLen && _bufPrepared + outLen < _contentLength) {
+		// Should not happen, but keep the framing intact if printing falls short
+		ESPWS_LOG("[%s] ERROR: Json printed short of measured length!\n",
+			_request->_remoteIdent.c_str());
+		memset(buf + outLen, ' ', maxLen - outLen);
+		outLen = maxLen;
+	}
+	return outLen;
+}
+
+void AsyncJsonWriter::_prefix(void) {
+	if (_keyed) {
+		_keyed = false;
+		return;
+	}
+	if (_depth) {
+		uint32_t bit = 1u << (_depth-1);
+		if (_filled & bit) _out.write(',');
+		_filled |= bit;
+	}
+}
+
+bool AsyncJsonWriter::_begin(bool object) {
+	if (_depth >= MaxDepth) {
+		ESPWS_DEBUG("[JsonWriter] ERROR: Nesting too deep\n");
+		return false;
+	}
+	_prefix();
+	_out.write(object? '{' : '[');
+	uint32_t bit = 1u << _depth++;
+	if (object) _objects |= bit;
+	else _objects &= ~bit;
+	_filled &= ~bit;
+	return true;
+}
+
+bool AsyncJsonWriter::end(void) {
+	if (!_depth) {
+		ESPWS_DEBUG("[JsonWriter] ERROR: No container to end\n");
+		return false;
+	}
+	_keyed = false;
+	_out.write((_objects & (1u << --_depth))? '}' : ']');
+	return true;
+}
+
+void AsyncJsonWriter::_string(char const *str, size_t len) {
+	_out.write('"');
+	char const *run = str;
+	char const *strEnd = str + len;
+	for (; str < strEnd; str++) {
+		char c = *str;
+		if (c != '"' && c != '\\' && (uint8_t)c >= 0x20) continue;
+		// Plain runs go out in one write
+		if (str > run) _out.write((uint8_t const*)run, str - run);
+		run = str + 1;
+		char esc[6] = {'\\', c, 0, 0, 0, 0};
+		switch (c) {
+			case '"': case '\\': break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+				esc[4] = HexLookup_UC[(c >> 4) & 0xF];
+				esc[5] = HexLookup_UC[c & 0xF];
+				_out.write((uint8_t const*)esc, 6);
+				continue;
+		}
+		_out.write((uint8_t const*)esc, 2);
+	}
+	if (str > run) _out.write((uint8_t const*)run, str - run);
+	_out.write('"');
+}
+
+AsyncJsonWriter& AsyncJsonWriter::key(char const *name, size_t len) {
+	_prefix();
+	_string(name, len);
+	_out.write(':');
+	_keyed = true;
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::key(__FlashStringHelper const *name) {
+	_prefix();
+	_out.write('"');
+	_out.print(name);
+	_out.write((uint8_t const*)"\":", 2);
+	_keyed = true;
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::value(char const *str, size_t len) {
+	_prefix();
+	_string(str, len);
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::value(bool val) {
+	_prefix();
+	if (val) _out.write((uint8_t const*)"true", 4);
+	else _out.write((uint8_t const*)"false", 5);
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::value(long val) {
+	_prefix();
+	_out.print(val);
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::value(unsigned long val) {
+	_prefix();
+	_out.print(val);
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::value(double val, uint8_t digits) {
+	if (isnan(val) || isinf(val)) return null();
+	_prefix();
+	_out.print(val, digits);
+	return *this;
+}
+
+AsyncJsonWriter& AsyncJsonWriter::null(void) {
+	_prefix();
+	_out.write((uint8_t const*)"null", 4);
+	return *this;
+}
+
+size_t AsyncJsonStreamResponse::CarryPrint::write(const uint8_t *buffer, size_t size) {
+	// Once anything is held back, the rest must queue behind it
+	size_t wlen = _carry.length()? 0 : min(size, _ring.space());
+	_ring.write(buffer, wlen);
+	if (wlen < size) _carry.concat((char const*)buffer+wlen, size-wlen);
+	return size;
+}
+
+void AsyncJsonStreamResponse::_printPiece(void) {
+	if (_carry.length()) {
+		size_t len = min(_carry.length() - _carryOfs, _ring.space());
+		_ring.write((uint8_t const*)_carry.begin() + _carryOfs, len);
+		_carryOfs += len;
+		if (_carryOfs < _carry.length()) return;
+		_carry.clear(true);
+		_carryOfs = 0;
+	} else if (!_lastPiece) _lastPiece = !_callback(_writer);
+
+	_done = _lastPiece && !_carry.length();
+	if (_done && _writer.depth()) {
+		ESPWS_LOG("[%s] ERROR: Json stream ended with %d open container(s)\n",
+			_request->_remoteIdent.c_str(), _writer.depth());
+	}
+}
+
+#ifdef HANDLE_REQUEST_CONTENT
+
+bool AsyncJsonWebHandler::_checkContinue(AsyncWebRequest &request, bool continueHeader) {
+	String const &contentType = request.contentType();
+	if (strncasecmp_P(contentType.c_str(), PSTR_C("application/json"), 16) != 0
+		|| (contentType[16] && contentType[16] != ';' && contentType[16] != ' ')) {
+		ESPWS_DEBUGVV("[%s] Not a JSON body: '%s'\n",
+			request._remoteIdent.c_str(), contentType.c_str());
+		request.send(415);
+		return false;
+	}
+
+	// Known length is checked before the client is asked to continue
+	size_t contentLength = request.contentLength();
+	if (contentLength == -1 && !request.chunked()) {
+		request.send(411);
+		return false;
+	}
+	if (contentLength != -1 && contentLength > maxContentLength) {
+		ESPWS_DEBUGV("[%s] JSON body too large (%d > %d)\n",
+			request._remoteIdent.c_str(), contentLength, maxContentLength);
+		request.send(413);
+		return false;
+	}
+
+	if (_getBodyRec(request)) {
+		ESPWS_DEBUGVV("[%s] JSON body record collision\n", request._remoteIdent.c_str());
+		request.send(500);
+		return false;
+	}
+	// Exactly sized when the length is known, otherwise grown as chunks arrive
+	size_t size = contentLength != -1? contentLength + 1 : 0;
+	char *text = size? (char*)malloc(size) : nullptr;
+	if (size && !text) {
+		request.send(500);
+		return false;
+	}
+	_bodies.append({&request, text, 0, size});
+	return AsyncPathURIWebHandler::_checkContinue(request, continueHeader);
+}
+
+void AsyncJsonWebHandler::_terminateRequest(AsyncWebRequest &request) {
+	_bodies.remove_if([&](BodyRec const &r){
+		return r.req == &request;
+	});
+}
+
+bool AsyncJsonWebHandler::_handleBody(AsyncWebRequest &request,
+	size_t offset, void *buf, size_t size) {
+	BodyRec *pRec = _getBodyRec(request);
+	if (!pRec || pRec->len != offset) return false;
+	if (pRec->len + size > maxContentLength) {
+		ESPWS_DEBUGV("[%s] JSON body overflow (%d > %d)\n",
+			request._remoteIdent.c_str(), pRec->len + size, maxContentLength);
+		request.send(413);
+		return false;
+	}
+	if (pRec->len + size >= pRec->size) {
+		size_t newSize = pRec->size? pRec->size : 256;
+		while (newSize <= pRec->len + size) newSize*= 2;
+		if (newSize > maxContentLength + 1) newSize = maxContentLength + 1;
+		char *text = (char*)realloc(pRec->text, newSize);
+		if (!text) return false;
+		pRec->text = text;
+		pRec->size = newSize;
+	}
+	memcpy(pRec->text + pRec->len, buf, size);
+	pRec->len+= size;
+	return true;
+}
+
+void AsyncJsonWebHandler::_handleRequest(AsyncWebRequest &request) {
+	BodyRec *pRec = _getBodyRec(request);
+	if (!pRec || !pRec->text) {
+		request.send(400);
+		return;
+	}
+	pRec->text[pRec->len] = '\0';
+
+	// Parsed in place, so the body text is the only copy of string values
+#ifdef ASYNCWEB_JSON_BUFFER_STATIC
+	AsyncJsonBuffer *jsonBuffer = new AsyncJsonBuffer();
+#else
+	BoundedOneshotAllocator bufferAllocator(maxJsonBuffer);
+	AsyncJsonBuffer *jsonBuffer = new AsyncJsonBuffer(bufferAllocator,
+		maxJsonBuffer-AsyncJsonBuffer::EmptyBlockSize);
+#endif
+	JsonVariant root = jsonBuffer->parse(pRec->text, ASYNCWEB_JSON_NESTING_LIMIT);
+	if (!root.success()) {
+		ESPWS_DEBUGV("[%s] Unable to parse JSON body (%d bytes)\n",
+			request._remoteIdent.c_str(), pRec->len);
+		request.send_P(400, PSTR_C("Malformed or oversized JSON document"), FC("text/plain"));
+	} else if (onJson) {
+		onJson(request, root);
+	} else request.send(204);
+	delete jsonBuffer;
+
+	// Release the body while responding
+	_terminateRequest(request);
+}
+
+#endif
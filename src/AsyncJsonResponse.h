@@ -20,11 +20,15 @@
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include "WebResponseImpl.h"
+#include "WebHandlerImpl.h"
 
 #include <functional>
 
 #define ASYNCWEB_JSON_MAXIMUM_BUFFER 2048
+#define ASYNCWEB_JSON_MAXIMUM_BODY   4096
 #define ASYNCWEB_JSON_NESTING_LIMIT  5
+#define ASYNCWEB_JSON_STREAM_BUFSIZE 1024
+#define ASYNCWEB_JSON_STREAM_PIECE   256
 
 // Try not to use static buffer unless absolutely necessary
 //#define ASYNCWEB_JSON_BUFFER_STATIC
@@ -37,6 +41,8 @@ typedef Internals::DynamicJsonBufferBase<BoundedOneshotAllocator> AsyncJsonBuffe
 #endif
 typedef std::function<JsonVariant(AsyncJsonBuffer &)> JsonCreateRootCallback;
 
+class JsonChunkPrint;
+
 class AsyncJsonResponse: public AsyncChunkedResponse {
 	private:
 #ifndef ASYNCWEB_JSON_BUFFER_STATIC
@@ -45,9 +51,34 @@ class AsyncJsonResponse: public AsyncChunkedResponse {
 		AsyncJsonBuffer _jsonBuffer;
 		JsonVariant _jsonRoot;
 		bool _prettyPrint;
+		bool _sized;
+
+		// Serialization resumes where the previous chunk stopped
+		struct PrintFrame {
+			bool isObject;
+			bool first;
+			JsonObject::iterator objIt, objEnd;
+			JsonArray::iterator arrIt, arrEnd;
+		};
+		PrintFrame *_stack;
+		uint8_t _depth;
+		uint8_t _stackSize;
+		bool _printStarted;
+		bool _printDone;
+		// Text that did not fit in the previous chunk
+		String _carry;
+		size_t _carryOfs;
 
+		void _printIndent(JsonChunkPrint &out, uint8_t depth);
+		void _printValue(JsonChunkPrint &out, JsonVariant const &value);
+		void _printStep(JsonChunkPrint &out);
 		size_t _JsonFiller(uint8_t*, size_t, size_t);
 
+	protected:
+		virtual void _assembleHead(void) override;
+		virtual void _prepareContentSendBuf(size_t space) override;
+		virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+
 	public:
 		JsonVariant &root;
 
@@ -68,10 +99,20 @@ class AsyncJsonResponse: public AsyncChunkedResponse {
 #endif
 			, _jsonRoot(std::move(root_cb(_jsonBuffer)))
 			, _prettyPrint(false)
+			, _sized(false)
+			, _stack(nullptr)
+			, _depth(0)
+			, _stackSize(0)
+			, _printStarted(false)
+			, _printDone(false)
+			, _carryOfs(0)
 			, root(_jsonRoot)
 			{}
+		~AsyncJsonResponse(void) { free(_stack); }
 
 		void setPrettyPrint(bool enable = true);
+		// Measures the document and sends it with a Content-Length instead of chunked
+		void setSizedResponse(bool enable = true);
 
 		JsonVariant parse(String const &json,
 			uint8_t nestingLimit = ASYNCWEB_JSON_NESTING_LIMIT) {
@@ -106,4 +147,167 @@ class AsyncJsonResponse: public AsyncChunkedResponse {
 				);
 		}
 };
-#endif
\ No newline at end of file
+
+// Writes JSON tokens straight to a Print, without building a document
+class AsyncJsonWriter {
+	private:
+		Print &_out;
+		uint32_t _objects; // Bit per level, set for objects
+		uint32_t _filled;  // Bit per level, set once the container has a member
+		uint8_t _depth;
+		bool _keyed;
+
+		void _prefix(void);
+		bool _begin(bool object);
+		void _string(char const *str, size_t len);
+
+	public:
+		static constexpr uint8_t MaxDepth = 32;
+
+		AsyncJsonWriter(Print &out)
+			: _out(out), _objects(0), _filled(0), _depth(0), _keyed(false)
+			{}
+
+		// Returns false if nested deeper than MaxDepth
+		bool beginObject(void) { return _begin(true); }
+		bool beginArray(void) { return _begin(false); }
+		// Closes the innermost container
+		bool end(void);
+		uint8_t depth(void) const { return _depth; }
+
+		AsyncJsonWriter& key(char const *name) { return key(name, strlen(name)); }
+		AsyncJsonWriter& key(String const &name) { return key(name.c_str(), name.length()); }
+		AsyncJsonWriter& key(char const *name, size_t len);
+		// Flash keys are printed verbatim, they must not need escaping
+		AsyncJsonWriter& key(__FlashStringHelper const *name);
+
+		AsyncJsonWriter& value(char const *str) { return value(str, strlen(str)); }
+		AsyncJsonWriter& value(String const &str) { return value(str.c_str(), str.length()); }
+		AsyncJsonWriter& value(char const *str, size_t len);
+		AsyncJsonWriter& value(bool val);
+		AsyncJsonWriter& value(int val) { return value((long)val); }
+		AsyncJsonWriter& value(unsigned int val) { return value((unsigned long)val); }
+		AsyncJsonWriter& value(long val);
+		AsyncJsonWriter& value(unsigned long val);
+		// Non-finite numbers are written as null
+		AsyncJsonWriter& value(double val, uint8_t digits = 4);
+		AsyncJsonWriter& null(void);
+};
+
+// Called once per piece, should write about the piece size;
+// returns false after writing the last piece
+//   (Text beyond the free ring space is held back, and sent before
+//    the next piece is requested)
+typedef std::function<bool(AsyncJsonWriter &)> JsonStreamCallback;
+
+class AsyncJsonStreamResponse: public AsyncRingChunkedResponse {
+	private:
+		// Writes into the ring, and keeps whatever does not fit
+		class CarryPrint: public Print {
+			private:
+				RingBufferPrint &_ring;
+				String &_carry;
+			public:
+				CarryPrint(RingBufferPrint &ring, String &carry)
+					: _ring(ring), _carry(carry)
+					{}
+
+				virtual size_t write(uint8_t c) override {
+					return write(&c, 1);
+				}
+
+				virtual size_t write(const uint8_t *buffer, size_t size) override;
+		};
+
+		JsonStreamCallback _callback;
+		String _carry;
+		size_t _carryOfs;
+		bool _lastPiece;
+		CarryPrint _print;
+		AsyncJsonWriter _writer;
+
+	protected:
+		virtual void _printPiece(void) override;
+
+	public:
+		AsyncJsonStreamResponse(JsonStreamCallback const &callback, int code = 200,
+			size_t bufSize = ASYNCWEB_JSON_STREAM_BUFSIZE,
+			size_t pieceMax = ASYNCWEB_JSON_STREAM_PIECE)
+			: AsyncRingChunkedResponse(code, FC("application/json"), bufSize, pieceMax)
+			, _callback(callback)
+			, _carryOfs(0)
+			, _lastPiece(false)
+			, _print(_ring, _carry)
+			, _writer(_print)
+			{}
+};
+
+#ifdef HANDLE_REQUEST_CONTENT
+
+/*
+ * JSON request handler :: Collects the request body and parses it in place,
+ * so that strings in the document refer to the received text
+ *   (The document is only valid during the onJson callback)
+ * */
+
+typedef std::function<void(AsyncWebRequest&, JsonVariant&)> ArJsonRequestHandlerFunction;
+
+class AsyncJsonWebHandler: public AsyncPathURIWebHandler {
+	protected:
+		struct BodyRec {
+			AsyncWebRequest *req;
+			char *text;
+			size_t len;
+			size_t size;
+		};
+		LinkedList<BodyRec> _bodies;
+
+		BodyRec* _getBodyRec(AsyncWebRequest &request) {
+			return _bodies.get_if([&](BodyRec const &r){
+				return r.req == &request;
+			});
+		}
+
+	public:
+		ArJsonRequestHandlerFunction onJson;
+		// Larger documents are rejected before receiving, or as soon as they overflow
+		size_t maxContentLength;
+		size_t maxJsonBuffer;
+
+		AsyncJsonWebHandler(String const &path, ArJsonRequestHandlerFunction const &cb,
+			WebRequestMethodComposite method = HTTP_POST | HTTP_PUT | HTTP_PATCH)
+			: AsyncPathURIWebHandler(path, method)
+			, _bodies([](BodyRec const &r){ free(r.text); })
+			, onJson(cb)
+			, maxContentLength(ASYNCWEB_JSON_MAXIMUM_BODY)
+			, maxJsonBuffer(ASYNCWEB_JSON_MAXIMUM_BUFFER)
+			{}
+
+		virtual bool _checkContinue(AsyncWebRequest &request, bool continueHeader) override;
+		virtual void _terminateRequest(AsyncWebRequest &request) override;
+		virtual void _handleRequest(AsyncWebRequest &request) override;
+
+		virtual bool _handleBody(AsyncWebRequest &request,
+			size_t offset, void *buf, size_t size) override;
+
+#if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
+		virtual bool _handleParamData(AsyncWebRequest &request, String const& name,
+			size_t offset, void *buf, size_t size) override {
+			// Do not expect request param
+			return false;
+		}
+#endif
+
+#ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
+		virtual bool _handleUploadData(AsyncWebRequest &request, String const& name,
+			String const& filename, String const& contentType,
+			size_t offset, void *buf, size_t size) override {
+			// Do not expect request upload
+			return false;
+		}
+#endif
+};
+
+#endif
+
+#endif
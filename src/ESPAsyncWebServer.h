@@ -85,13 +85,17 @@
 //#define AUTHENTICATION_ENABLE_SESS_BUGCOMPAT
 
 #define STATIC_GET_GZLOOKUP
+#define STATIC_GET_BRLOOKUP
 //#define STATIC_GET_GZFIRST
+//#define STATIC_DIRLIST_LAZY
 #define STATIC_ADVANCED_WEBHANDLER
 
 #define HANDLE_WEBDAV
 
 //#define ADVERTISE_ACCEPTRANGES
 
+#define RESPONSE_COMPRESSION // Gzip textual chunked responses on the fly
+
 //#define PLATFORM_SIGNATURE
 
 //#define REQUEST_USERAGENT
@@ -102,6 +106,7 @@
 
 #define REQUEST_PARAM_MEMCACHE    512
 #define REQUEST_PARAM_KEYMAX      128
+#define REQUEST_INDEX_MIN         8         // Longer lists get a hashed name index
 #define REQUEST_DISCARD_IDLE      500       // Unit ms
 
 #define DEFAULT_IDLE_TIMEOUT      10        // Unit s
@@ -109,6 +114,19 @@
 #define DEFAULT_CACHE_CTRL        "private, no-cache"
 #define DEFAULT_INDEX_FILE        "index.htm"
 
+#define STATIC_PATHCACHE_SIZE     16
+#define STATIC_PATHCACHE_TTL      5000      // Unit ms
+#define STATIC_DIRLIST_PAGE       64        // Default JSON listing page size
+#define STATIC_DIRLIST_PAGEMAX    256
+#define STATIC_UPLOAD_WRITEBUF    4096      // Power of 2, no less than 512
+#define STATIC_UPLOAD_MINHEAP     8192      // Heap to leave when sizing write buffer
+#define STATIC_DAV_COPYBUF        2048
+#define STATIC_DAV_COPYSLICE      4         // Unit ms, copy time per scheduler tick
+#define STATIC_DAV_LOCKMAX        8
+#define STATIC_DAV_LOCKTIMEOUT    3600      // Unit s, also the longest granted
+#define RESPONSE_DEFLATE_WINDOW   10        // Window bits (9-14), uses 6x window + 2KB of heap
+#define RESPONSE_DEFLATE_MINHEAP  12288     // Heap to leave, otherwise sent uncompressed
+
 #ifdef HANDLE_AUTHENTICATION
 #define DEFAULT_REALM             "ESPAsyncWeb"
 #define DEFAULT_NONCE_LIFE        120
@@ -178,16 +196,17 @@ class AsyncWebHeader {
 };
 
 /*
- * QUERY :: Hold a query key and value
+ * QUERY :: View of a decoded query key and value
+ *   (Valid until the request URL changes, or the request starts responding)
  * */
 
 class AsyncWebQuery {
 	public:
-		String name;
-		String value;
+		char const *name;
+		char const *value;
 
-		AsyncWebQuery(String const &n, String const &v): name(n), value(v) {}
-		AsyncWebQuery(String &&n, String &&v): name(std::move(n)), value(std::move(v)) {}
+		AsyncWebQuery(char const *n = nullptr, char const *v = nullptr): name(n), value(v) {}
+		explicit operator bool() const { return name != nullptr; }
 };
 
 #ifdef HANDLE_REQUEST_CONTENT
@@ -216,6 +235,109 @@ class AsyncWebUpload : public AsyncWebParam {
 
 #endif
 
+/*
+ * INDEX :: Open-addressing name lookup over request items, built once a list grows long
+ * */
+
+template<typename T, bool NoCase>
+class AsyncWebNameIndex {
+	protected:
+		struct Slot {
+			uint32_t hash;
+			T *item;
+		};
+		Slot *_slots;
+		size_t _mask;
+		size_t _count;
+
+		static char const* _nameOf(char const *item) { return item; }
+		template<typename U>
+		static char const* _nameOf(U const *item) { return item->name.c_str(); }
+
+		static bool _equals(char const *a, char const *b)
+		{ return (NoCase? strcasecmp(a, b) : strcmp(a, b)) == 0; }
+
+		static uint32_t _hash(char const *name) {
+			uint32_t hash = 2166136261UL;
+			while (*name) {
+				uint8_t c = *name++;
+				if (NoCase && c >= 'A' && c <= 'Z') c|= 0x20;
+				hash = (hash ^ c) * 16777619UL;
+			}
+			return hash;
+		}
+
+		bool _resize(size_t size) {
+			Slot *slots = (Slot*)calloc(size, sizeof(Slot));
+			if (!slots) return false;
+			if (_slots) for (size_t i = 0; i <= _mask; i++) {
+				if (!_slots[i].item) continue;
+				size_t pos = _slots[i].hash & (size - 1);
+				while (slots[pos].item) pos = (pos + 1) & (size - 1);
+				slots[pos] = _slots[i];
+			}
+			free(_slots);
+			_slots = slots;
+			_mask = size - 1;
+			return true;
+		}
+
+	public:
+		AsyncWebNameIndex(void): _slots(nullptr), _mask(0), _count(0) {}
+		AsyncWebNameIndex(AsyncWebNameIndex const&) = delete;
+		~AsyncWebNameIndex(void) { free(_slots); }
+
+		bool built(void) const { return _slots != nullptr; }
+		void clear(void) {
+			free(_slots);
+			_slots = nullptr;
+			_mask = _count = 0;
+		}
+
+		// A duplicate name keeps the earlier item, unless replacing
+		//   (Out of memory drops the index, and lookups fall back to scanning)
+		bool add(T *item, bool replace = false) {
+			if (!_slots || (_count + 1) * 4 > (_mask + 1) * 3) {
+				if (!_resize(_slots? (_mask + 1) * 2 : REQUEST_INDEX_MIN * 2)) {
+					clear();
+					return false;
+				}
+			}
+			uint32_t hash = _hash(_nameOf(item));
+			size_t pos = hash & _mask;
+			while (_slots[pos].item) {
+				if (_slots[pos].hash == hash && _equals(_nameOf(_slots[pos].item), _nameOf(item))) {
+					if (replace) _slots[pos].item = item;
+					return true;
+				}
+				pos = (pos + 1) & _mask;
+			}
+			_slots[pos] = {hash, item};
+			_count++;
+			return true;
+		}
+
+		// Indexes an item just appended, or the whole list once it grows long
+		void append(LinkedList<T> &list, T &item) {
+			if (_slots) add(&item);
+			else if (list.length() > REQUEST_INDEX_MIN) {
+				for (auto &entry : list)
+					if (!add(&entry)) break;
+			}
+		}
+
+		T* find(char const *name) const {
+			uint32_t hash = _hash(name);
+			size_t pos = hash & _mask;
+			while (_slots[pos].item) {
+				if (_slots[pos].hash == hash && _equals(_nameOf(_slots[pos].item), name))
+					return _slots[pos].item;
+				pos = (pos + 1) & _mask;
+			}
+			return nullptr;
+		}
+};
+
 class AsyncWebServer;
 class AsyncWebParser;
 class AsyncWebRewrite;
@@ -238,9 +360,29 @@ typedef enum {
 	REQUEST_FINALIZE
 } WebServerRequestState;
 
+// Value of a hex digit, or -1
+int8_t hexDigitValue(char c);
 String urlDecode(char const *buf, size_t len);
 String urlEncode(char const *buf, size_t len);
 
+typedef enum {
+	ENCODING_IDENTITY = 0,
+	ENCODING_GZIP,
+	ENCODING_BROTLI,
+	ENCODING_COUNT
+} WebContentEncoding;
+
+// Fills per-encoding q-values (0-1000) from an Accept-Encoding header value
+void parseAcceptEncoding(char const *str, uint16_t *qvals);
+
+// HTTP (IMF-fixdate) timestamp helpers, parse returns -1 on failure
+size_t printHTTPDate(time_t ts, char *buf, size_t len);
+time_t parseHTTPDate(char const *str);
+// Strong entity tag of a file version, as served by AsyncStaticWebHandler
+size_t printFileETag(size_t size, time_t mtime, char *buf, size_t len);
+// Matches an entity tag against an If-None-Match list (weak comparison)
+bool matchETagList(char const *list, char const *etag);
+
 typedef enum {
 	REQUEST_CLEANUP_STAGE1 = 0x01,
 	REQUEST_CLEANUP_STAGE2 = 0x02,
@@ -282,6 +424,10 @@ class AsyncWebRequest {
 		String _url;
 		String _oUrl;
 		String _oQuery;
+		// Decoded query pairs ("name\0value\0"...), parsed on first access
+		mutable String _queryBuf;
+		mutable size_t _queryCnt;
+		mutable AsyncWebNameIndex<char, false> _queryIndex;
 
 		String _host;
 		String _accept;
@@ -297,6 +443,9 @@ class AsyncWebRequest {
 #endif
 		String _contentType;
 		size_t _contentLength;
+#ifdef HANDLE_REQUEST_CONTENT
+		bool _chunked;
+#endif
 
 		bool _keepAlive;
 #ifdef HANDLE_WEBDAV
@@ -310,16 +459,21 @@ class AsyncWebRequest {
 #endif
 
 		LinkedList<AsyncWebHeader> _headers;
-		LinkedList<AsyncWebQuery> _queries;
+		AsyncWebNameIndex<AsyncWebHeader, true> _headerIndex;
 
 #ifdef HANDLE_REQUEST_CONTENT
 
 #if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
-		LinkedList<AsyncWebParam> _params;
+		// Query names ending in "[]" are also listed here, copied on first access
+		mutable LinkedList<AsyncWebParam> _params;
+		mutable AsyncWebNameIndex<AsyncWebParam, false> _paramIndex;
+		mutable bool _queryParams;
+		void _addQueryParams(void) const;
 #endif
 
 #ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
 		LinkedList<AsyncWebUpload> _uploads;
+		AsyncWebNameIndex<AsyncWebUpload, false> _uploadIndex;
 #endif
 
 #endif
@@ -332,15 +486,16 @@ class AsyncWebRequest {
 
 		void _setUrl(String const& url) { _setUrl(String(url)); }
 		void _setUrl(String &&url);
-		void _parseQueries(char *buf);
+		void _parseQueries(void) const;
 
 #ifdef HANDLE_AUTHENTICATION
 		WebACLMatchResult _setSession(WebAuthSession *session);
 #endif
 
 		template<typename T>
-		T& _addUniqueNameVal(LinkedList<T>& storage, String &name, String &value) {
-			T* qPtr = storage.get_if([&](T const &v) {
+		T& _addUniqueNameVal(LinkedList<T>& storage, AsyncWebNameIndex<T, false>& index,
+			String &name, String &value) {
+			T* qPtr = index.built()? index.find(name.c_str()) : storage.get_if([&](T const &v) {
 				return name == v.name;
 			});
 			if (qPtr) {
@@ -350,6 +505,7 @@ class AsyncWebRequest {
 				return *qPtr;
 			} else {
 				storage.append(T(std::move(name), std::move(value)));
+				index.append(storage, storage.back());
 				return storage.back();
 			}
 		}
@@ -401,7 +557,11 @@ class AsyncWebRequest {
 		String const &contentType(void) const { return _contentType; }
 		bool contentType(String const &type) const
 		{ return _contentType.equalsIgnoreCase(type); }
+		// Unknown (-1) for a chunked body, until it is completely received
 		size_t contentLength(void) const { return _contentLength; }
+#ifdef HANDLE_REQUEST_CONTENT
+		bool chunked(void) const { return _chunked; }
+#endif
 
 #ifdef HANDLE_AUTHENTICATION
 		WebAuthSession* session(void) const { return _session; }
@@ -410,26 +570,27 @@ class AsyncWebRequest {
 		size_t headers(void) const { return _headers.length(); }
 		bool hasHeader(String const &name) const;
 		AsyncWebHeader const* getHeader(String const &name) const;
+		AsyncWebHeader const* getHeader_P(PGM_P name) const;
 
 		void enumHeaders(LinkedList<AsyncWebHeader>::Predicate const& Pred)
 		{ _headers.get_if(Pred); }
 
-		size_t queries(void) const { return _queries.length(); }
-		bool hasQuery(String const &name) const;
-		AsyncWebQuery const* getQuery(String const &name) const;
+		size_t queries(void) const;
+		bool hasQuery(String const &name) const { return (bool)getQuery(name); }
+		// Last occurrence of the name, or an empty view
+		AsyncWebQuery getQuery(String const &name) const;
 
-		void enumQueries(LinkedList<AsyncWebQuery>::Predicate const& Pred)
-		{ _queries.get_if(Pred); }
+		void enumQueries(std::function<bool(AsyncWebQuery const&)> const& Pred) const;
 
 #ifdef HANDLE_REQUEST_CONTENT
 
 #if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
-		size_t params(void) const { return _params.length(); }
+		size_t params(void) const { _addQueryParams(); return _params.length(); }
 		bool hasParam(String const &name) const;
 		AsyncWebParam const* getParam(String const &name) const;
 
 		void enumParams(LinkedList<AsyncWebParam>::Predicate const& Pred)
-		{ _params.get_if(Pred); }
+		{ _addQueryParams(); _params.get_if(Pred); }
 #endif
 
 #ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
@@ -609,6 +770,8 @@ class AsyncWebHandler : public AsyncWebFilterable {
 			size_t offset, void *buf, size_t size) = 0;
 
 #if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
+		// Fields not kept in request params are only passed to _handleParamData()
+		virtual bool _keepParam(AsyncWebRequest &request, String const& name) { return true; }
 		virtual bool _handleParamData(AsyncWebRequest &request, String const& name,
 			size_t offset, void *buf, size_t size) = 0;
 #endif
@@ -646,6 +809,7 @@ class AsyncPassthroughWebHandler : public AsyncWebHandler {
 
 class AsyncCallbackWebHandler;
 class AsyncStaticWebHandler;
+class AsyncPackWebHandler;
 
 #ifdef HANDLE_AUTHENTICATION
 typedef enum {
@@ -847,6 +1011,10 @@ class AsyncWebServer {
 #endif
 		);
 
+		AsyncPackWebHandler& servePack(String const &uri, PGM_VOID_P pack,
+			String const &indexFile = DEFAULT_INDEX_FILE,
+			String const &cache_control = DEFAULT_CACHE_CTRL);
+
 		// Called when handler is not assigned
 		void catchAll(ArRequestHandlerFunction const& onRequest);
 
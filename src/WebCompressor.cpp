@@ -0,0 +1,197 @@
+/*
+	Asynchronous WebServer library for Espressif MCUs
+
+	Copyright (c) 2026 ESPAsyncWebServer contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "WebCompressor.h"
+
+#define DEFLATE_MIN_MATCH  3
+#define DEFLATE_MAX_MATCH  258
+#define DEFLATE_STEP_MAX   5  // Output bytes one literal or match may produce
+#define DEFLATE_TAIL_MAX   10 // End of block, padding and gzip trailer
+
+static uint16_t const LengthBase[] PROGMEM = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static uint16_t const DistBase[] PROGMEM = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static uint32_t const Crc32Nibble[] PROGMEM = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+GzipDeflater::GzipDeflater(uint8_t windowBits)
+	: _winSize(1 << windowBits)
+	, _win((uint8_t*)malloc(_winSize * 2))
+	, _head((uint16_t*)calloc(1 << DEFLATE_HASH_BITS, sizeof(uint16_t)))
+	, _prev((uint16_t*)malloc(_winSize * 2 * sizeof(uint16_t)))
+	, _pos(0), _end(0)
+	, _stage(GZIP_HEADER)
+	, _crc(0xFFFFFFFF), _size(0)
+	, _bitBuf(0), _bitCnt(0)
+	, _out(nullptr), _outLen(0)
+{}
+
+GzipDeflater::~GzipDeflater(void) {
+	free(_win);
+	free(_head);
+	free(_prev);
+}
+
+uint8_t *GzipDeflater::inputBuffer(size_t &len) {
+	// Slide once the encoded half is no longer needed as history
+	if (_end == _winSize * 2 && _pos >= _winSize) {
+		memmove(_win, _win + _winSize, _winSize);
+		_pos-= _winSize;
+		_end-= _winSize;
+		for (size_t i = 0; i < (1 << DEFLATE_HASH_BITS); i++)
+			_head[i] = _head[i] > _winSize? _head[i] - _winSize : 0;
+		for (size_t i = 0; i < _winSize; i++) {
+			uint16_t prev = _prev[i + _winSize];
+			_prev[i] = prev > _winSize? prev - _winSize : 0;
+		}
+	}
+	len = _winSize * 2 - _end;
+	return _win + _end;
+}
+
+void GzipDeflater::commitInput(size_t len) {
+	uint8_t const *in = _win + _end;
+	for (size_t i = 0; i < len; i++) {
+		_crc^= in[i];
+		_crc = (_crc >> 4) ^ pgm_read_dword(&Crc32Nibble[_crc & 0xF]);
+		_crc = (_crc >> 4) ^ pgm_read_dword(&Crc32Nibble[_crc & 0xF]);
+	}
+	_size+= len;
+	_end+= len;
+}
+
+void GzipDeflater::_insert(size_t pos) {
+	uint16_t &slot = _head[_hash(pos)];
+	_prev[pos] = slot;
+	slot = pos + 1;
+}
+
+uint16_t GzipDeflater::_hash(size_t pos) const {
+	uint32_t val = (_win[pos] << 16) | (_win[pos+1] << 8) | _win[pos+2];
+	val*= 2654435761UL;
+	return val >> (32 - DEFLATE_HASH_BITS);
+}
+
+void GzipDeflater::_putBits(uint32_t bits, uint8_t cnt) {
+	_bitBuf|= bits << _bitCnt;
+	_bitCnt+= cnt;
+	while (_bitCnt >= 8) {
+		_out[_outLen++] = _bitBuf;
+		_bitBuf>>= 8;
+		_bitCnt-= 8;
+	}
+}
+
+void GzipDeflater::_putCode(uint16_t code, uint8_t len) {
+	// Huffman codes are packed starting from the most significant bit
+	uint16_t rev = 0;
+	for (uint8_t i = len; i--; code>>= 1) rev = (rev << 1) | (code & 1);
+	_putBits(rev, len);
+}
+
+void GzipDeflater::_putSymbol(uint16_t sym) {
+	// Fixed literal/length code (RFC 1951, 3.2.6)
+	if (sym < 144) _putCode(0x30 + sym, 8);
+	else if (sym < 256) _putCode(0x190 + sym - 144, 9);
+	else if (sym < 280) _putCode(sym - 256, 7);
+	else _putCode(0xC0 + sym - 280, 8);
+}
+
+void GzipDeflater::_putMatch(size_t len, size_t dist) {
+	uint8_t i = 0;
+	while (i < 28 && pgm_read_word(&LengthBase[i+1]) <= len) i++;
+	_putSymbol(257 + i);
+	_putBits(len - pgm_read_word(&LengthBase[i]), (i < 8 || i == 28)? 0 : (i - 4) >> 2);
+
+	i = 0;
+	while (i < 29 && pgm_read_word(&DistBase[i+1]) <= dist) i++;
+	_putCode(i, 5);
+	_putBits(dist - pgm_read_word(&DistBase[i]), i < 4? 0 : (i - 2) >> 1);
+}
+
+size_t GzipDeflater::deflate(uint8_t *out, size_t len, bool finish) {
+	_out = out;
+	_outLen = 0;
+
+	if (_stage == GZIP_HEADER) {
+		if (len < 10 + DEFLATE_STEP_MAX) return 0;
+		// No name, no timestamp, unknown OS
+		static uint8_t const GzipHeader[] PROGMEM = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+		memcpy_P(out, GzipHeader, 10);
+		_outLen = 10;
+		// The whole stream is one final fixed-Huffman block
+		_putBits(1, 1);
+		_putBits(1, 2);
+		_stage = GZIP_DATA;
+	}
+
+	if (_stage == GZIP_DATA) {
+		// Unless finishing, keep enough lookahead for the longest match
+		size_t limit = finish? _end : (_end > DEFLATE_MAX_MATCH? _end - DEFLATE_MAX_MATCH : 0);
+		while (_pos < limit && len - _outLen >= DEFLATE_STEP_MAX) {
+			size_t matchLen = 0;
+			size_t dist = 0;
+			if (_pos + DEFLATE_MIN_MATCH <= _end) {
+				size_t maxLen = _end - _pos;
+				if (maxLen > DEFLATE_MAX_MATCH) maxLen = DEFLATE_MAX_MATCH;
+				uint16_t next = _head[_hash(_pos)];
+				for (uint8_t chain = DEFLATE_MAX_CHAIN; next && chain--;) {
+					size_t cand = next - 1;
+					size_t candLen = 0;
+					while (candLen < maxLen && _win[cand+candLen] == _win[_pos+candLen])
+						candLen++;
+					if (candLen > matchLen) {
+						matchLen = candLen;
+						dist = _pos - cand;
+						if (matchLen == maxLen) break;
+					}
+					next = _prev[cand];
+				}
+				_insert(_pos);
+			}
+			if (matchLen >= DEFLATE_MIN_MATCH) {
+				_putMatch(matchLen, dist);
+				size_t matchEnd = _pos + matchLen;
+				while (++_pos < matchEnd && _pos + DEFLATE_MIN_MATCH <= _end)
+					_insert(_pos);
+				_pos = matchEnd;
+			} else _putSymbol(_win[_pos++]);
+		}
+
+		if (finish && _pos == _end && len - _outLen >= DEFLATE_TAIL_MAX) {
+			_putSymbol(256);
+			if (_bitCnt) _putBits(0, 8 - _bitCnt);
+			uint32_t crc = ~_crc;
+			for (uint8_t i = 0; i < 4; i++, crc>>= 8) out[_outLen++] = crc;
+			for (uint8_t i = 0; i < 4; i++, _size>>= 8) out[_outLen++] = _size;
+			_stage = GZIP_DONE;
+		}
+	}
+	return _outLen;
+}
@@ -0,0 +1,84 @@
+/*
+	Asynchronous WebServer library for Espressif MCUs
+
+	Copyright (c) 2026 ESPAsyncWebServer contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef AsyncWebCompressor_H_
+#define AsyncWebCompressor_H_
+
+#include <Arduino.h>
+
+#define DEFLATE_HASH_BITS 10
+#define DEFLATE_MAX_CHAIN 8
+// The window must hold a full match (258 bytes) of lookahead;
+// positions (+1) of both window halves must fit in uint16_t
+#define DEFLATE_MIN_WINDOW 9
+#define DEFLATE_MAX_WINDOW 14
+
+// Streaming gzip encoder, sized for small heaps:
+// LZ77 over a short window (bounded hash chains), coded as one fixed-Huffman block.
+// Input is staged directly in the window; output is produced as buffer room permits.
+class GzipDeflater {
+	private:
+		typedef enum {
+			GZIP_HEADER,
+			GZIP_DATA,
+			GZIP_DONE,
+		} GzipStage;
+
+		size_t const _winSize;
+		uint8_t *_win;     // History, followed by input not yet encoded
+		uint16_t *_head;   // Last position (+1) of each 3-byte hash
+		uint16_t *_prev;   // Previous position (+1) with the same hash
+		size_t _pos;
+		size_t _end;
+		GzipStage _stage;
+		uint32_t _crc;
+		uint32_t _size;
+
+		uint32_t _bitBuf;
+		uint8_t _bitCnt;
+		uint8_t *_out;
+		size_t _outLen;
+
+		uint16_t _hash(size_t pos) const;
+		void _insert(size_t pos);
+		void _putBits(uint32_t bits, uint8_t cnt);
+		void _putCode(uint16_t code, uint8_t len);
+		void _putSymbol(uint16_t sym);
+		void _putMatch(size_t len, size_t dist);
+
+	public:
+		// Window of 2^windowBits bytes, DEFLATE_MIN_WINDOW to DEFLATE_MAX_WINDOW
+		GzipDeflater(uint8_t windowBits);
+		~GzipDeflater(void);
+
+		static size_t memoryNeeded(uint8_t windowBits)
+		{ return (6 << windowBits) + (sizeof(uint16_t) << DEFLATE_HASH_BITS); }
+		bool valid(void) const { return _win && _head && _prev; }
+
+		// Where the next input goes; len is zero when the window is full
+		uint8_t *inputBuffer(size_t &len);
+		void commitInput(size_t len);
+		// Encodes staged input into out, returns bytes written;
+		// with finish, ends the stream once all input is encoded
+		size_t deflate(uint8_t *out, size_t len, bool finish);
+		bool finished(void) const { return _stage == GZIP_DONE; }
+};
+
+#endif // AsyncWebCompressor_H_
@@ -24,9 +24,17 @@
 #include "stddef.h"
 #include <time.h>
 #include <FS.h>
+#include <MD5Builder.h>
 
 #include <ESPAsyncWebServer.h>
 
+#if defined(STATIC_ADVANCED_WEBHANDLER) && defined(HANDLE_WEBDAV)
+extern "C" {
+	#include "osapi.h"
+	#include "user_interface.h"
+}
+#endif
+
 class AsyncHostRedirWebHandler: public AsyncWebHandler {
 	protected:
 		void _redirectHost(AsyncWebRequest &request) {
@@ -117,7 +125,42 @@ class AsyncStaticWebHandler: public AsyncPathURIWebHandler {
 		Dir _dir;
 		String _cache_control;
 		String _GET_indexFile;
-		bool _GET_gzLookup, _GET_gzFirst;
+		DirListFormat _GET_dirListFormat;
+		// Encoded variants to look for, in order of preference
+		uint8_t _GET_encOrder[ENCODING_COUNT];
+		uint8_t _GET_encCount;
+
+		// Bit (1 << WebContentEncoding) marks an existing variant
+		typedef enum {
+			PATHREC_PLAIN  = 1 << ENCODING_IDENTITY,
+			PATHREC_GZIP   = 1 << ENCODING_GZIP,
+			PATHREC_BROTLI = 1 << ENCODING_BROTLI,
+			PATHREC_DIR    = 0x80,
+		} PathRecFlags;
+
+		struct PathMeta {
+			size_t size;
+			time_t mtime;
+			char etag[24];
+		};
+
+		// Bounded record of recent path resolutions (including misses),
+		//   saves repeated directory walks on the underlying file system
+		struct PathCacheRec {
+			String path;
+			uint8_t flags;
+			uint32_t ts;
+			PathMeta meta[ENCODING_COUNT];
+			// Last variant selection (0xFF if none), keyed by Accept-Encoding hash
+			uint32_t selHash;
+			uint8_t selEnc;
+		};
+		LinkedList<PathCacheRec> _pathCache;
+		PathCacheRec& _resolvePath(String const &subpath);
+		void _invalidatePath(String const &subpath);
+		static void _fillPathMeta(PathMeta &meta, File &file);
+		uint8_t _selectEncoding(AsyncWebRequest &request, PathCacheRec &rec);
+		bool _notModified(AsyncWebRequest &request, PathMeta const &meta);
 
 		void _GET_sendDirList(AsyncWebRequest &request);
 		void _pathNotFound(AsyncWebRequest &request);
@@ -129,23 +172,63 @@ class AsyncStaticWebHandler: public AsyncPathURIWebHandler {
 			AsyncWebRequest *req;
 			File file;
 			size_t pos;
+			// Write-back buffer, keeps file writes sector-aligned
+			uint8_t *buf;
+			size_t bufSize;
+			size_t bufLen;
+			// Running digest, only when the client supplied one to check
+			MD5Builder *md5;
+			char md5Expect[25];
 		};
 		LinkedList<UploadRec> _uploads;
+		UploadRec *_uploadMRU;
+		UploadRec* _getUploadRec(AsyncWebRequest &request);
+		bool _flushUpload(UploadRec &rec);
+		bool _verifyUpload(AsyncWebRequest &request, UploadRec &rec);
 		bool _checkContinueCanWrite(AsyncWebRequest &request, bool continueHeader);
 		bool _checkContinueCanDelete(AsyncWebRequest &request, bool continueHeader);
-		//bool _checkContinueDAV(AsyncWebRequest &request, bool continueHeader);
+#ifdef HANDLE_WEBDAV
+		// Exclusive write locks, expired by a timer armed for the nearest expiry
+		struct LockRec {
+			uint32_t hash; // FNV-1a of path
+			uint32_t expire;
+			bool deep;
+			String path;
+			char token[37]; // UUID, without the "opaquelocktoken:" scheme
+		};
+		LockRec _locks[STATIC_DAV_LOCKMAX];
+		uint8_t _lockCnt;
+		os_timer_t _lockTimer = {0};
+		static void _lockTimerThunk(void *arg)
+		{ ((AsyncStaticWebHandler*)arg)->_sweepLocks(); }
+		void _sweepLocks(void);
+		// Finds a lock on `subpath` or its ancestors (or descendants, if `deep`),
+		//   skipping those whose token appears in `tokens`
+		LockRec* _findLock(String const &subpath, bool deep, char const *tokens = nullptr);
+		static bool _lockCovers(LockRec const &lock, String const &subpath);
+		bool _checkDAVLocks(AsyncWebRequest &request, String const &subpath, bool deep);
+
+		bool _checkContinueDAVList(AsyncWebRequest &request, bool continueHeader);
+		bool _checkContinueDAVCopy(AsyncWebRequest &request, bool continueHeader);
+		// Returns 0 on success, or the status code to reject the request with
+		int _getDAVDestination(AsyncWebRequest &request, String &subpath);
+#endif
 
 		bool _handleUploadBody(AsyncWebRequest &request,
 			size_t offset, void *buf, size_t size);
 
 		void _handleWrite(AsyncWebRequest &request);
 		void _handleDelete(AsyncWebRequest &request);
-		//void _handleDAVOptions(AsyncWebRequest &request);
-		//void _handleDAVList(AsyncWebRequest &request);
+		void _handleOptions(AsyncWebRequest &request);
+#ifdef HANDLE_WEBDAV
+		void _handleDAVList(AsyncWebRequest &request);
 		//void _handleDAVWriteAttr(AsyncWebRequest &request);
 		//void _handleDAVMakeDir(AsyncWebRequest &request);
-		//void _handleDAVCopy(AsyncWebRequest &request);
-		//void _handleDAVMove(AsyncWebRequest &request);
+		void _handleDAVCopy(AsyncWebRequest &request, bool move);
+		void _handleDAVLock(AsyncWebRequest &request);
+		void _handleDAVUnlock(AsyncWebRequest &request);
+		void _sendLockInfo(AsyncWebRequest &request, int code, LockRec const &lock, bool newLock);
+#endif
 #endif
 
 	public:
@@ -162,6 +245,9 @@ class AsyncStaticWebHandler: public AsyncPathURIWebHandler {
 #endif
 #endif
 		);
+#if defined(STATIC_ADVANCED_WEBHANDLER) && defined(HANDLE_WEBDAV)
+		~AsyncStaticWebHandler() { os_timer_disarm(&_lockTimer); }
+#endif
 
 		virtual bool _isInterestingHeader(AsyncWebRequest const &request, String const& key) override;
 #ifdef STATIC_ADVANCED_WEBHANDLER
@@ -171,7 +257,11 @@ class AsyncStaticWebHandler: public AsyncPathURIWebHandler {
 
 		AsyncStaticWebHandler& setCacheControl(String const &cache_control);
 		AsyncStaticWebHandler& setGETLookupGZ(bool gzLookup, bool gzFirst);
+		// Up to ENCODING_COUNT variants, ENCODING_COUNT marks unused slots
+		AsyncStaticWebHandler& setGETEncodingOrder(WebContentEncoding first,
+			WebContentEncoding second = ENCODING_COUNT, WebContentEncoding third = ENCODING_COUNT);
 		AsyncStaticWebHandler& setGETIndexFile(String const &filename);
+		AsyncStaticWebHandler& setGETDirList(DirListFormat format);
 
 		virtual void _handleRequest(AsyncWebRequest &request) override;
 
@@ -208,6 +298,79 @@ class AsyncStaticWebHandler: public AsyncPathURIWebHandler {
 #endif
 };
 
+// Read-only asset pack, produced at build time by tools/mkwebpack.py
+//   Layout (little-endian, 4-byte aligned):
+//   - PackHead, followed by (bucketCount + 1) uint16 bucket start indices
+//   - PackEntry array, grouped by hash bucket
+//   - NUL-terminated strings (names, ETags, header blocks) and content bodies
+#define WEBPACK_MAGIC   0x4B505357 // "WSPK"
+
+class AsyncPackWebHandler: public AsyncPathURIWebHandler {
+	protected:
+		struct PackHead {
+			uint32_t magic;
+			uint16_t entryCount;
+			uint16_t bucketCount; // Power of 2
+		};
+
+		struct PackEntry {
+			uint32_t hash;     // FNV-1a of name
+			uint32_t nameOfs;
+			uint32_t etagOfs;
+			uint32_t headOfs;  // Pre-formatted header lines
+			uint32_t bodyOfs;
+			uint32_t bodyLen;
+			uint32_t encoding; // WebContentEncoding
+		};
+
+		uint8_t const *_pack;
+		uint16_t _bucketCount;
+		String _cache_control;
+		String _indexFile;
+
+		bool _lookup(char const *name, PackEntry &entry) const;
+		uint8_t _lookupVariants(String const &subpath, PackEntry *entries) const;
+		String _subPath(AsyncWebRequest const &request) const;
+
+	public:
+		AsyncPackWebHandler(String const &path, PGM_VOID_P pack);
+
+		virtual bool _canHandle(AsyncWebRequest const &request) override;
+		virtual bool _isInterestingHeader(AsyncWebRequest const &request, String const& key) override;
+		virtual void _handleRequest(AsyncWebRequest &request) override;
+
+		AsyncPackWebHandler& setCacheControl(String const &cache_control)
+		{ _cache_control = cache_control; return *this; }
+		AsyncPackWebHandler& setIndexFile(String const &filename)
+		{ _indexFile = filename; return *this; }
+
+#ifdef HANDLE_REQUEST_CONTENT
+		virtual bool _handleBody(AsyncWebRequest &request,
+			size_t offset, void *buf, size_t size) override {
+			// Do not expect request body
+			return false;
+		}
+
+#if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
+		virtual bool _handleParamData(AsyncWebRequest &request, String const& name,
+			size_t offset, void *buf, size_t size) override {
+			// Do not expect request param
+			return false;
+		}
+#endif
+
+#ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
+		virtual bool _handleUploadData(AsyncWebRequest &request, String const& name,
+			String const& filename, String const& contentType,
+			size_t offset, void *buf, size_t size) override {
+			// Do not expect request upload
+			return false;
+		}
+#endif
+
+#endif
+};
+
 class AsyncCallbackWebHandler : virtual public AsyncWebHandler {
 	public:
 		ArRequestHandlerFunction onRequest;
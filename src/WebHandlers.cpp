@@ -21,8 +21,6 @@
 
 #include "WebHandlerImpl.h"
 
-#include <Units.h>
-
 /*
  * Abstract handler
  * */
@@ -127,20 +125,40 @@ AsyncStaticWebHandler::AsyncStaticWebHandler(String const &path, Dir const &dir
 	, _dir(dir)
 	//, _cache_control()
 	//, _GET_indexFile()
+	, _pathCache(nullptr)
 #ifdef STATIC_ADVANCED_WEBHANDLER
-	, _uploads(nullptr)
+	, _uploads([](UploadRec const &r){ free(r.buf); delete r.md5; })
+	, _uploadMRU(nullptr)
+#ifdef HANDLE_WEBDAV
+	, _lockCnt(0)
+#endif
 #endif
 {
+#if defined(STATIC_ADVANCED_WEBHANDLER) && defined(HANDLE_WEBDAV)
+	os_timer_setfn(&_lockTimer, &_lockTimerThunk, this);
+#endif
 	// Set defaults
 #ifdef STATIC_GET_GZLOOKUP
-	_GET_gzLookup = true;
+#ifdef STATIC_GET_BRLOOKUP
+#ifdef STATIC_GET_GZFIRST
+	setGETEncodingOrder(ENCODING_BROTLI, ENCODING_GZIP, ENCODING_IDENTITY);
 #else
-	_GET_gzLookup = false;
+	setGETEncodingOrder(ENCODING_IDENTITY, ENCODING_BROTLI, ENCODING_GZIP);
 #endif
+#else
 #ifdef STATIC_GET_GZFIRST
-	_GET_gzFirst = true;
+	setGETEncodingOrder(ENCODING_GZIP, ENCODING_IDENTITY);
+#else
+	setGETEncodingOrder(ENCODING_IDENTITY, ENCODING_GZIP);
+#endif
+#endif
+#else
+	setGETEncodingOrder(ENCODING_IDENTITY);
+#endif
+#ifdef STATIC_DIRLIST_LAZY
+	_GET_dirListFormat = DIRLIST_HTML_LAZY;
 #else
-	_GET_gzFirst = false;
+	_GET_dirListFormat = DIRLIST_HTML;
 #endif
 	//_onGETIndex = nullptr;
 	_onGETPathNotFound = std::bind(&AsyncStaticWebHandler::_pathNotFound, this, std::placeholders::_1);
@@ -160,28 +178,175 @@ AsyncStaticWebHandler& AsyncStaticWebHandler::setGETIndexFile(String const &file
 	return *this;
 }
 
+AsyncStaticWebHandler& AsyncStaticWebHandler::setGETDirList(DirListFormat format) {
+	_GET_dirListFormat = format;
+	return *this;
+}
+
 AsyncStaticWebHandler& AsyncStaticWebHandler::setGETLookupGZ(bool gzLookup, bool gzFirst) {
-	_GET_gzLookup = gzLookup;
-	_GET_gzFirst = gzFirst;
+	if (!gzLookup) return setGETEncodingOrder(ENCODING_IDENTITY);
+	return gzFirst? setGETEncodingOrder(ENCODING_GZIP, ENCODING_IDENTITY)
+		: setGETEncodingOrder(ENCODING_IDENTITY, ENCODING_GZIP);
+}
+
+AsyncStaticWebHandler& AsyncStaticWebHandler::setGETEncodingOrder(WebContentEncoding first,
+	WebContentEncoding second, WebContentEncoding third) {
+	WebContentEncoding const order[] = {first, second, third};
+	_GET_encCount = 0;
+	bool hasIdentity = false;
+	for (WebContentEncoding enc : order) {
+		if (enc >= ENCODING_COUNT) continue;
+		if (memchr(_GET_encOrder, enc, _GET_encCount)) continue;
+		_GET_encOrder[_GET_encCount++] = enc;
+		hasIdentity|= enc == ENCODING_IDENTITY;
+	}
+	// Plain files are always servable, as a last resort
+	if (!hasIdentity) _GET_encOrder[_GET_encCount++] = ENCODING_IDENTITY;
+	// Cached records may lack the variant we now look for
+	_pathCache.clear();
+	return *this;
+}
+
+static PGM_P _encodingExt(uint8_t enc) {
+	switch (enc) {
+		case ENCODING_GZIP: return PSTR_C(".gz");
+		case ENCODING_BROTLI: return PSTR_C(".br");
+		default: return PSTR_C("");
+	}
+}
+
+static PGM_P _encodingName(uint8_t enc) {
+	switch (enc) {
+		case ENCODING_GZIP: return PSTR_C("gzip");
+		case ENCODING_BROTLI: return PSTR_C("br");
+		default: return PSTR_C("identity");
+	}
+}
+
+void AsyncStaticWebHandler::_fillPathMeta(PathMeta &meta, File &file) {
+	meta.size = file.size();
+	meta.mtime = file.mtime();
+	// Pre-formatted, so conditional checks need no allocation
+	printFileETag(meta.size, meta.mtime, meta.etag, sizeof(meta.etag));
+}
+
+AsyncStaticWebHandler::PathCacheRec& AsyncStaticWebHandler::_resolvePath(String const &subpath) {
+	uint32_t curTS = millis();
+	PathCacheRec* PRec = _pathCache.get_if([&](PathCacheRec const &r){
+		return r.path == subpath;
+	});
+	if (PRec) {
+		if (curTS - PRec->ts < STATIC_PATHCACHE_TTL) {
+			ESPWS_DEBUGVV("Path cache hit '%s' [%02X]\n", subpath.c_str(), PRec->flags);
+			return *PRec;
+		}
+		ESPWS_DEBUGVV("Path cache expired '%s'\n", subpath.c_str());
+	} else {
+		if (_pathCache.append({subpath, 0, 0}) >= STATIC_PATHCACHE_SIZE)
+			_pathCache.remove_nth(0);
+		PRec = &_pathCache.back();
+	}
+
+	PRec->flags = 0;
+	PRec->ts = curTS;
+	PRec->selEnc = 0xFF;
+	for (uint8_t i = 0; i < _GET_encCount; i++) {
+		uint8_t enc = _GET_encOrder[i];
+		String encPath = subpath;
+		encPath.concat(FPSTR(_encodingExt(enc)));
+		File Probe = _dir.openFile(encPath.c_str(), "r");
+		if (Probe) {
+			PRec->flags|= 1 << enc;
+			_fillPathMeta(PRec->meta[enc], Probe);
+		}
+	}
+	// Only worth checking when there is no file to serve
+	if (!PRec->flags && _dir.isDir(subpath))
+		PRec->flags = PATHREC_DIR;
+	ESPWS_DEBUGVV("Path cache fill '%s' [%02X]\n", subpath.c_str(), PRec->flags);
+	return *PRec;
+}
+
+void AsyncStaticWebHandler::_invalidatePath(String const &subpath) {
+	// Over-invalidation is harmless, so drop anything related by prefix
+	//   (covers compressed variants, parent and children of a directory)
+	while (_pathCache.remove_if([&](PathCacheRec const &r){
+		return r.path.startsWith(subpath) || subpath.startsWith(r.path);
+	}));
+}
+
+uint8_t AsyncStaticWebHandler::_selectEncoding(AsyncWebRequest &request, PathCacheRec &rec) {
+	String const &acceptEncoding = request.acceptEncoding();
+	// FNV-1a, clients tend to send the same header value on every request
+	uint32_t hash = 2166136261UL;
+	for (char c : acceptEncoding) hash = (hash ^ (uint8_t)c) * 16777619UL;
+	if (rec.selEnc != 0xFF && rec.selHash == hash) return rec.selEnc;
+
+	uint16_t qvals[ENCODING_COUNT];
+	parseAcceptEncoding(acceptEncoding.c_str(), qvals);
+	// Highest q-value wins, configured order breaks the tie
+	uint8_t sel = ENCODING_COUNT;
+	for (uint8_t i = 0; i < _GET_encCount; i++) {
+		uint8_t enc = _GET_encOrder[i];
+		if (!(rec.flags & (1 << enc)) || !qvals[enc]) continue;
+		if (sel == ENCODING_COUNT || qvals[enc] > qvals[sel]) sel = enc;
+	}
+	rec.selHash = hash;
+	rec.selEnc = sel;
+	return sel;
+}
+
+bool AsyncStaticWebHandler::_notModified(AsyncWebRequest &request, PathMeta const &meta) {
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("If-None-Match"));
+	if (Header) {
+		for (auto const &value : Header->values)
+			if (matchETagList(value.c_str(), meta.etag)) return true;
+		// If-Modified-Since is ignored when If-None-Match is present
+		return false;
+	}
+	Header = request.getHeader_P(PSTR_C("If-Modified-Since"));
+	if (Header && meta.mtime) {
+		for (auto const &value : Header->values) {
+			time_t ts = parseHTTPDate(value.c_str());
+			return ts != -1 && meta.mtime <= ts;
+		}
+	}
+	return false;
 }
 
 bool AsyncStaticWebHandler::_isInterestingHeader(AsyncWebRequest const &request, String const &key) {
 	switch (request.method()) {
 		case HTTP_GET:
 		case HTTP_HEAD:
-			return key.equalsIgnoreCase(FC("If-None-Match"));
+			return key.equalsIgnoreCase(FC("If-None-Match")) ||
+				key.equalsIgnoreCase(FC("If-Modified-Since"));
 			break;
 
 #ifdef STATIC_ADVANCED_WEBHANDLER
+		case HTTP_PUT:
+			return key.equalsIgnoreCase(FC("Content-MD5")) ||
+				key.equalsIgnoreCase(FC("Digest"))
+#ifdef HANDLE_WEBDAV
+				|| key.equalsIgnoreCase(FC("If"))
+#endif
+				;
 #ifdef HANDLE_WEBDAV
+		case HTTP_DELETE:
+			return key.equalsIgnoreCase(FC("If"));
 		case HTTP_PROPFIND:
 			return key.equalsIgnoreCase(FC("Depth")) ||
 				key.equalsIgnoreCase(FC("Brief"));
 		case HTTP_COPY:
-			return key.equalsIgnoreCase(FC("Depth")) ||
-				key.equalsIgnoreCase(FC("Destination"));
 		case HTTP_MOVE:
-			return key.equalsIgnoreCase(FC("Destination"));
+			return key.equalsIgnoreCase(FC("Destination")) ||
+				key.equalsIgnoreCase(FC("Overwrite")) ||
+				key.equalsIgnoreCase(FC("If"));
+		case HTTP_LOCK:
+			return key.equalsIgnoreCase(FC("Depth")) ||
+				key.equalsIgnoreCase(FC("Timeout")) ||
+				key.equalsIgnoreCase(FC("If"));
+		case HTTP_UNLOCK:
+			return key.equalsIgnoreCase(FC("Lock-Token"));
 #endif
 #endif
 	}
@@ -204,13 +369,33 @@ void AsyncStaticWebHandler::_handleRequest(AsyncWebRequest &request) {
 			_handleDelete(request);
 			break;
 
-#ifdef HANDLE_WEBDAV
 		case HTTP_OPTIONS:
+			_handleOptions(request);
+			break;
+
+#ifdef HANDLE_WEBDAV
 		case HTTP_PROPFIND:
-		case HTTP_PROPPATCH:
-		case HTTP_MKCOL:
+			_handleDAVList(request);
+			break;
+
 		case HTTP_COPY:
+			_handleDAVCopy(request, false);
+			break;
+
 		case HTTP_MOVE:
+			_handleDAVCopy(request, true);
+			break;
+
+		case HTTP_LOCK:
+			_handleDAVLock(request);
+			break;
+
+		case HTTP_UNLOCK:
+			_handleDAVUnlock(request);
+			break;
+
+		case HTTP_PROPPATCH:
+		case HTTP_MKCOL:
 #endif
 
 #endif
@@ -259,37 +444,61 @@ void AsyncStaticWebHandler::_handleRead(AsyncWebRequest &request) {
 		}
 	}
 
-	bool gzEncode = _GET_gzLookup &&
-		(request.acceptEncoding().indexOf(FC("gzip")) >= 0);
+	uint8_t encSel = ENCODING_IDENTITY;
 
 	File CWF;
+	PathMeta CWMeta;
 	// Handle file request path
 	if (subpath) {
 		ESPWS_DEBUGVV("[%s] File lookup: '%s'\n",
 			request._remoteIdent.c_str(), subpath.c_str());
-		if (gzEncode) {
-			String gzPath = subpath + ".gz";
-			if (_GET_gzFirst) {
-				ESPWS_DEBUGVV("[%s] GZFirst: '%s'\n",
-					request._remoteIdent.c_str(), gzPath.c_str());
-				CWF = _dir.openFile(gzPath.c_str(), "r");
-				if (!CWF) {
-					gzEncode = false;
-					CWF = _dir.openFile(subpath.c_str(), "r");
-				}
-			} else {
-				CWF = _dir.openFile(subpath.c_str(), "r");
-				if (!CWF) {
-					ESPWS_DEBUGVV("[%s] !GZFirst: '%s'\n",
-						request._remoteIdent.c_str(), gzPath.c_str());
-					CWF = _dir.openFile(gzPath.c_str(), "r");
-				} else gzEncode = false;
+		PathCacheRec *PRec = &_resolvePath(subpath);
+		uint8_t pathFlags = PRec->flags;
+		if (pathFlags & ~PATHREC_DIR) {
+			encSel = _selectEncoding(request, *PRec);
+			if (encSel == ENCODING_COUNT) {
+				ESPWS_DEBUGVV("[%s] No acceptable variant\n", request._remoteIdent.c_str());
+				// Without a plain copy, the resource does not exist for this client
+				if (pathFlags & PATHREC_PLAIN) request.send(406);
+				else _onGETPathNotFound(request);
+				return;
+			}
+			CWMeta = PRec->meta[encSel];
+			// Conditional requests are answered from the cached metadata
+			if (_notModified(request, CWMeta)) {
+				ESPWS_DEBUGVV("[%s] Not modified\n", request._remoteIdent.c_str());
+				AsyncWebResponse * response = request.beginResponse(304);
+				response->addHeader(FC("ETag"), CWMeta.etag);
+				if (_cache_control)
+					response->addHeader(FC("Cache-Control"), _cache_control);
+				if (_GET_encCount > 1)
+					response->addHeader(FC("Vary"), FC("Accept-Encoding"));
+				request.send(response);
+				return;
 			}
-		} else CWF = _dir.openFile(subpath.c_str(), "r");
+
+			String encPath = subpath;
+			encPath.concat(FPSTR(_encodingExt(encSel)));
+			ESPWS_DEBUGVV("[%s] Variant: '%s'\n",
+				request._remoteIdent.c_str(), encPath.c_str());
+			CWF = _dir.openFile(encPath.c_str(), "r");
+			if (CWF && (CWF.size() != CWMeta.size || CWF.mtime() != CWMeta.mtime)) {
+				// Content changed behind our back, refresh metadata
+				_invalidatePath(subpath);
+				CWMeta = _resolvePath(subpath).meta[encSel];
+			}
+			if (!CWF) {
+				// Stale record, file must have changed behind our back
+				ESPWS_DEBUGV("[%s] Stale path record '%s'\n",
+					request._remoteIdent.c_str(), subpath.c_str());
+				_invalidatePath(subpath);
+				pathFlags = _resolvePath(subpath).flags;
+			}
+		}
 
 		if (!CWF && !ServeDir) {
 			// Check the possibility that it is a dir
-			if (_dir.isDir(subpath)) {
+			if (pathFlags & PATHREC_DIR) {
 				// It is a dir that needs a gentle push
 				ESPWS_DEBUGVV("[%s] Dir redirect\n", request._remoteIdent.c_str());
 				_onDirRedirect(request);
@@ -311,26 +520,22 @@ void AsyncStaticWebHandler::_handleRead(AsyncWebRequest &request) {
 	}
 
 	// We can serve a data file
-	String etag;
-	if (_cache_control){
-		time_t fm = CWF.mtime();
-		size_t fs = CWF.size();
-		etag = "W/\""+String(fs)+'@'+String(fm,16)+'"';
-		auto Header = request.getHeader(FC("If-None-Match"));
-		if (Header != nullptr && Header->values.contains(etag)) {
-			request.send(304); // Not modified
-			return;
-		}
-	}
-
 	ESPWS_DEBUGVV("[%s] Serving '%s'\n", request._remoteIdent.c_str(), CWF.name());
 	AsyncWebResponse * response = new AsyncFileResponse(CWF, subpath);
+	response->addHeader(FC("ETag"), CWMeta.etag);
+	if (CWMeta.mtime) {
+		char DateBuf[32];
+		if (printHTTPDate(CWMeta.mtime, DateBuf, sizeof(DateBuf)))
+			response->addHeader(FC("Last-Modified"), DateBuf);
+	}
 	if (_cache_control) {
 		response->addHeader(FC("Cache-Control"), _cache_control);
-		response->addHeader(FC("ETag"), etag);
 	}
-	if (gzEncode) {
-		response->addHeader(FC("Content-Encoding"), FC("gzip"));
+	if (encSel != ENCODING_IDENTITY) {
+		response->addHeader(FC("Content-Encoding"), FPSTR(_encodingName(encSel)));
+	}
+	if (_GET_encCount > 1) {
+		response->addHeader(FC("Vary"), FC("Accept-Encoding"));
 	}
 	request.send(response);
 }
@@ -345,104 +550,37 @@ void AsyncStaticWebHandler::_GET_sendDirList(AsyncWebRequest &request) {
 		return;
 	}
 
-	uint32_t startTS = millis();
-	ESPWS_DEBUGV("[%s] Sending dir listing of '%s'\n", request._remoteIdent.c_str(), CWD.name());
-	String OvfBuf;
-	OvfBuf.concat(FC("<!DOCTYPE html><html><head><title>Directory content of '"));
-	OvfBuf.concat(request.url());
-	OvfBuf.concat(FC("'</title><style>table{width:100%;border-collapse:collapse}"
-		"th{background:#DDD;text-align:right}th:first-child{text-align:left}"
-		"td{text-align:right}td:first-child{text-align:left}"
-		".footnote{font-size:small}.left{float:left}.right{float:right}</style></head>"
-		"<body><h1>Directory '"));
-	OvfBuf.concat(request.url());
-	OvfBuf.concat(FC("'</h1><hr><table><thead>"
-		"<tr><th>Name</th><th>Content</th><th>Modification Time</th></tr>"
-		"</thead><tbody>"));
-	if (subpath)
-		OvfBuf.concat(FC("<tr><td><a href='..'>(Parent folder)</a></td><td></td><td></td></tr>"));
-	CWD.next(true);
-
-	auto response = request.beginChunkedResponse(200,
-		[=,&request](uint8_t* buf, size_t len, size_t offset) mutable -> size_t {
-			size_t outLen = 0;
-			if (OvfBuf) {
-				outLen = OvfBuf.length() < len? OvfBuf.length(): len;
-				memcpy(buf,OvfBuf.begin(),outLen);
-				if (outLen >= OvfBuf.length()) OvfBuf.clear();
-				else OvfBuf.remove(0, outLen);
+	DirListFormat format = _GET_dirListFormat;
+	AsyncWebQuery Query = request.getQuery(FC("format"));
+	if (Query && strcasecmp_P(Query.value, PSTR_C("json")) == 0) format = DIRLIST_JSON;
+
+	// JSON listings are always paged, so that per-request work stays bounded
+	uint32_t cursor = 0, limit = 0;
+	if (format == DIRLIST_JSON) {
+		limit = STATIC_DIRLIST_PAGE;
+		Query = request.getQuery(FC("limit"));
+		char *end;
+		if (Query) {
+			limit = strtoul(Query.value, &end, 10);
+			if (end == Query.value || *end || !limit) {
+				request.send(400);
+				return;
 			}
-			while (CWD && outLen < len) {
-				if (CWD.entryName()) {
-					{
-						String EntryRef = CWD.entryName();
-						if (CWD.isEntryDir()) EntryRef.concat('/');
-						OvfBuf.concat(FC("<tr><td><a href='"));
-						OvfBuf.concat(EntryRef);
-						OvfBuf.concat(FC("'>"));
-						OvfBuf.concat(EntryRef);
-					}
-					OvfBuf.concat(FC("</a></td><td>"));
-					if (CWD.isEntryDir()) {
-						// Feed the dog before it bites
-						ESP.wdtFeed();
-						OvfBuf.concat(FC("&lt;"));
-						Dir _subdir = CWD.openEntryDir();
-						if (_subdir) {
-							size_t file_count = 0, dir_count = 0;
-							while (_subdir.next()) {
-								if (_subdir.isEntryDir()) ++dir_count;
-								else ++file_count;
-							}
-							if (file_count+dir_count) {
-								if (file_count) {
-									OvfBuf.concat(file_count);
-									OvfBuf.concat(FC(" file"));
-									if (file_count>1) OvfBuf.concat('s');
-								}
-								if (dir_count) {
-									if (file_count) OvfBuf.concat(FC(", "));
-									OvfBuf.concat(dir_count);
-									OvfBuf.concat(FC(" folder"));
-									if (dir_count>1) OvfBuf.concat('s');
-								}
-							} else {
-								OvfBuf.concat(FC("empty"));
-							}
-						} else {
-							OvfBuf.concat(FC("inaccessible"));
-						}
-						OvfBuf.concat(FC("&gt;"));
-					} else {
-						OvfBuf.concat(ToString(CWD.entrySize(),SizeUnit::BYTE,true));
-					}
-					OvfBuf.concat(FC("</td><td>"));
-					time_t mtime = CWD.entryMtime();
-					char strbuf[30];
-					OvfBuf.concat(ctime_r(&mtime, strbuf));
-					OvfBuf.concat(FC("</td></tr>"));
-					CWD.next();
-				} else {
-					uint32_t endTS = millis();
-					OvfBuf.concat(FC("</tbody></table><hr><div class='footnote'>"
-						"<span class='left'>Served by "));
-					OvfBuf.concat(FPSTR(AsyncWebServer::VERTOKEN));
-					OvfBuf.concat(FC(" ("));
-					OvfBuf.concat(GetPlatformSignature());
-					OvfBuf.concat(FC(")</span><span class='right'>Generated in "));
-					OvfBuf.concat(endTS-startTS);
-					OvfBuf.concat(FC("ms</span></div></body></html>"));
-					CWD = Dir();
-				}
-				size_t moveLen = OvfBuf.length() < len-outLen? OvfBuf.length(): len-outLen;
-				memcpy(buf+outLen,OvfBuf.begin(),moveLen);
-				if (moveLen >= OvfBuf.length()) OvfBuf.clear();
-				else OvfBuf.remove(0, moveLen);
-				outLen+= moveLen;
+			if (limit > STATIC_DIRLIST_PAGEMAX) limit = STATIC_DIRLIST_PAGEMAX;
+		}
+		Query = request.getQuery(FC("cursor"));
+		if (Query) {
+			cursor = strtoul(Query.value, &end, 10);
+			if (end == Query.value || *end) {
+				request.send(400);
+				return;
 			}
-			return outLen;
-		}, "text/html");
-	request.send(response);
+		}
+	}
+
+	ESPWS_DEBUGV("[%s] Sending dir listing of '%s' [%d+%d]\n", request._remoteIdent.c_str(),
+		CWD.name(), cursor, limit);
+	request.send(new AsyncDirListResponse(CWD, format, subpath.length() != 0, cursor, limit));
 }
 
 void AsyncStaticWebHandler::_pathNotFound(AsyncWebRequest &request) {
@@ -467,6 +605,24 @@ bool AsyncStaticWebHandler::_checkContinue(AsyncWebRequest &request, bool contin
 			if (!_checkContinueCanDelete(request, continueHeader)) return false;
 			break;
 
+		case HTTP_OPTIONS:
+			break;
+
+#ifdef HANDLE_WEBDAV
+		case HTTP_PROPFIND:
+			if (!_checkContinueDAVList(request, continueHeader)) return false;
+			break;
+
+		case HTTP_COPY:
+		case HTTP_MOVE:
+			if (!_checkContinueDAVCopy(request, continueHeader)) return false;
+			break;
+
+		case HTTP_LOCK:
+		case HTTP_UNLOCK:
+			break;
+#endif
+
 		default:
 			ESPWS_DEBUG("WARNING: Unimplemented method '%s'\n",
 				SFPSTR(AsyncWebServer::mapMethod(request.method())));
@@ -478,12 +634,35 @@ bool AsyncStaticWebHandler::_checkContinue(AsyncWebRequest &request, bool contin
 
 void AsyncStaticWebHandler::_terminateRequest(AsyncWebRequest &request) {
 	if (request.method() == HTTP_PUT) {
+		_uploadMRU = nullptr;
 		_uploads.remove_if([&](UploadRec const &r){
 			return r.req == &request;
 		});
 	}
 }
 
+#define UPLOAD_SECTOR 512
+
+static size_t _uploadBufSize(size_t contentLength) {
+	size_t bufSize = STATIC_UPLOAD_WRITEBUF;
+	// No point buffering beyond the content
+	while (bufSize > UPLOAD_SECTOR && bufSize / 2 >= contentLength) bufSize/= 2;
+	// Leave enough heap for everything else
+	while (bufSize >= UPLOAD_SECTOR && ESP.getFreeHeap() < bufSize + STATIC_UPLOAD_MINHEAP)
+		bufSize/= 2;
+	return bufSize >= UPLOAD_SECTOR? bufSize : 0;
+}
+
+static bool _writeFully(File &file, uint8_t const *data, size_t len) {
+	while (len) {
+		size_t outLen = file.write(data, len);
+		if (!outLen) return false;
+		data+= outLen;
+		len-= outLen;
+	}
+	return true;
+}
+
 bool AsyncStaticWebHandler::_checkContinueCanWrite(AsyncWebRequest &request, bool continueHeader) {
 	String subpath = request.url().substring(path.length());
 
@@ -496,8 +675,12 @@ bool AsyncStaticWebHandler::_checkContinueCanWrite(AsyncWebRequest &request, boo
 		return false;
 	}
 
-	// Check content length
+	// Check content length (a chunked body reveals it at the end)
+#ifdef HANDLE_REQUEST_CONTENT
+	if (request.contentLength() == -1 && !request.chunked()) {
+#else
 	if (request.contentLength() == -1) {
+#endif
 		ESPWS_DEBUGVV("[%s] Missing content-length header\n", request._remoteIdent.c_str());
 		request.send(411);
 		return false;
@@ -512,10 +695,12 @@ bool AsyncStaticWebHandler::_checkContinueCanWrite(AsyncWebRequest &request, boo
 		return false;
 	}
 
+#ifdef HANDLE_WEBDAV
+	if (!_checkDAVLocks(request, subpath, false)) return false;
+#endif
+
 	// Check if we already have a record
-	if (_uploads.get_if([&](UploadRec const &r){
-		return r.req == &request;
-		})) {
+	if (_getUploadRec(request)) {
 		ESPWS_DEBUGVV("[%s] Upload record collision\n", request._remoteIdent.c_str());
 		request.send(500);
 		return false;
@@ -531,16 +716,109 @@ bool AsyncStaticWebHandler::_checkContinueCanWrite(AsyncWebRequest &request, boo
 		request.send(500);
 		return false;
 	}
+	// Reserve space up-front, so that running out of storage fails fast
+	//   (Note: file systems that cannot seek past the end skip this step)
+	size_t contentLength = request.contentLength();
+	if (contentLength && contentLength != -1 && _file.seek(contentLength - 1, SeekSet)) {
+		if (_file.write((uint8_t)0) != 1 || !_file.seek(0, SeekSet)) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to reserve %d bytes for upload\n",
+				request._remoteIdent.c_str(), contentLength);
+			_file.close();
+			_dir.remove(upload_path);
+			request.send(507);
+			return false;
+		}
+	}
+
+	// Check for client supplied digest
+	char md5Expect[25] = {0};
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Content-MD5"));
+	if (Header) {
+		for (auto const &value : Header->values) {
+			strncpy(md5Expect, value.c_str(), sizeof(md5Expect) - 1);
+			break;
+		}
+	} else if ((Header = request.getHeader_P(PSTR_C("Digest")))) {
+		for (auto const &value : Header->values) {
+			// Other algorithms are not available
+			if (strncasecmp_P(value.c_str(), PSTR_C("md5="), 4) == 0) {
+				strncpy(md5Expect, value.c_str() + 4, sizeof(md5Expect) - 1);
+				break;
+			}
+		}
+	}
+	MD5Builder *md5 = nullptr;
+	if (md5Expect[0]) {
+		md5 = new MD5Builder();
+		md5->begin();
+	}
+
 	// Stash file record
-	_uploads.append({&request, _file, 0});
+	size_t bufSize = _uploadBufSize(contentLength);
+	uint8_t *buf = bufSize? (uint8_t*)malloc(bufSize) : nullptr;
+	ESPWS_DEBUGVV("[%s] Upload write buffer %d, digest '%s'\n", request._remoteIdent.c_str(),
+		buf? bufSize : 0, md5Expect);
+	_uploads.append({&request, _file, 0, buf, buf? bufSize : 0, 0, md5});
+	strcpy(_uploads.back().md5Expect, md5Expect);
 	return AsyncWebHandler::_checkContinue(request, continueHeader);
 }
 
+AsyncStaticWebHandler::UploadRec* AsyncStaticWebHandler::_getUploadRec(AsyncWebRequest &request) {
+	// Consecutive chunks almost always belong to the same upload
+	if (_uploadMRU && _uploadMRU->req == &request) return _uploadMRU;
+	UploadRec* pRec = _uploads.get_if([&](UploadRec const &r){
+		return r.req == &request;
+	});
+	if (pRec) _uploadMRU = pRec;
+	return pRec;
+}
+
+bool AsyncStaticWebHandler::_verifyUpload(AsyncWebRequest &request, UploadRec &rec) {
+	if (!rec.md5) return true;
+	static char const Base64[] PROGMEM =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint8_t digest[16];
+	rec.md5->calculate();
+	rec.md5->getBytes(digest);
+	char encoded[25];
+	char *out = encoded;
+	for (int i = 0; i < 16; i+= 3) {
+		uint32_t triple = digest[i] << 16;
+		if (i+1 < 16) triple|= digest[i+1] << 8;
+		if (i+2 < 16) triple|= digest[i+2];
+		*out++ = pgm_read_byte(Base64 + ((triple >> 18) & 0x3F));
+		*out++ = pgm_read_byte(Base64 + ((triple >> 12) & 0x3F));
+		*out++ = i+1 < 16? pgm_read_byte(Base64 + ((triple >> 6) & 0x3F)) : '=';
+		*out++ = i+2 < 16? pgm_read_byte(Base64 + (triple & 0x3F)) : '=';
+	}
+	*out = '\0';
+	if (strcmp(encoded, rec.md5Expect) == 0) return true;
+	ESPWS_DEBUG("[%s] WARNING: Upload digest mismatch (expect '%s', got '%s')\n",
+		request._remoteIdent.c_str(), rec.md5Expect, encoded);
+	return false;
+}
+
+bool AsyncStaticWebHandler::_flushUpload(UploadRec &rec) {
+	bool Ret = _writeFully(rec.file, rec.buf, rec.bufLen);
+	rec.bufLen = 0;
+	return Ret;
+}
+
 bool AsyncStaticWebHandler::_handleBody(AsyncWebRequest &request,
 	size_t offset, void *buf, size_t size) {
 	switch (request.method()) {
 		case HTTP_PUT:
 			return _handleUploadBody(request, offset, buf, size);
+
+#ifdef HANDLE_WEBDAV
+		case HTTP_PROPFIND:
+			// Requested properties are not examined, we always reply with the full set
+			return true;
+
+		case HTTP_LOCK:
+			// Only exclusive write locks are granted, whatever the lock info says
+			return true;
+#endif
 	}
 
 	// Do not expect request body
@@ -550,9 +828,7 @@ bool AsyncStaticWebHandler::_handleBody(AsyncWebRequest &request,
 bool AsyncStaticWebHandler::_handleUploadBody(AsyncWebRequest &request,
 	size_t offset, void *buf, size_t size) {
 	// Check if upload record has been established
-	UploadRec* pRec = _uploads.get_if([&](UploadRec const &r){
-		return r.req == &request;
-	});
+	UploadRec* pRec = _getUploadRec(request);
 	if (!pRec) {
 		ESPWS_DEBUG("[%s] WARNING: Upload record not available\n",
 		request._remoteIdent.c_str());
@@ -568,19 +844,37 @@ bool AsyncStaticWebHandler::_handleUploadBody(AsyncWebRequest &request,
 		request._remoteIdent.c_str(), request.contentLength(), pRec->pos + size);
 		return false;
 	}
-	size_t bufofs = 0;
-	while (size > bufofs) {
-		size_t outlen = pRec->file.write(((uint8_t*)buf)+bufofs, size-bufofs);
-		if (outlen < 0) {
-			ESPWS_DEBUG("[%s] WARNING: Upload file write failed!\n",
-			request._remoteIdent.c_str());
-			return false;
+	pRec->pos+= size;
+	if (pRec->md5) pRec->md5->add((uint8_t*)buf, size);
+
+	uint8_t *data = (uint8_t*)buf;
+	bool written = true;
+	while (size && written) {
+		if (!pRec->bufLen && size >= pRec->bufSize) {
+			// Nothing pending, whole buffer-sized spans go straight to the file
+			size_t directLen = pRec->bufSize? size - size % pRec->bufSize : size;
+			written = _writeFully(pRec->file, data, directLen);
+			data+= directLen;
+			size-= directLen;
+			continue;
 		}
-		pRec->pos+= outlen;
-		bufofs += outlen;
+		size_t copyLen = pRec->bufSize - pRec->bufLen;
+		if (copyLen > size) copyLen = size;
+		memcpy(pRec->buf + pRec->bufLen, data, copyLen);
+		pRec->bufLen+= copyLen;
+		data+= copyLen;
+		size-= copyLen;
+		if (pRec->bufLen == pRec->bufSize) written = _flushUpload(*pRec);
+	}
+	// Flush the tail as soon as the last piece arrives
+	if (written && pRec->pos == request.contentLength()) written = _flushUpload(*pRec);
+	if (!written) {
+		ESPWS_DEBUG("[%s] WARNING: Upload file write failed!\n",
+		request._remoteIdent.c_str());
+		return false;
 	}
-	ESPWS_DEBUGVV("[%s] Upload written %d ->@%d\n",
-	request._remoteIdent.c_str(), size, pRec->pos);
+	ESPWS_DEBUGVV("[%s] Upload received ->@%d (%d buffered)\n",
+	request._remoteIdent.c_str(), pRec->pos, pRec->bufLen);
 	return true;
 }
 
@@ -593,45 +887,83 @@ bool AsyncStaticWebHandler::_checkContinueCanDelete(AsyncWebRequest &request, bo
 		request.send(403);
 		return false;
 	}
+#ifdef HANDLE_WEBDAV
+	if (subpath.end()[-1] == '/') subpath.remove(subpath.length()-1);
+	if (!_checkDAVLocks(request, subpath, true)) return false;
+#endif
 	return AsyncWebHandler::_checkContinue(request, continueHeader);
 }
 
 void AsyncStaticWebHandler::_handleWrite(AsyncWebRequest &request) {
 	// Check if upload record has been established
-	UploadRec rec;
-	if (!_uploads.remove_nth_if(0,[&](UploadRec const &r){
-			return r.req == &request;
-		}, [&](UploadRec const &r){
-			return rec = std::move(r), true;
-		})) {
+	UploadRec* pRec = _getUploadRec(request);
+	if (!pRec) {
 		ESPWS_DEBUG("[%s] WARNING: Upload record not available\n",
 			request._remoteIdent.c_str());
 		request.send(400);
 		return;
 	}
-	if (rec.pos != request.contentLength()) {
+	bool flushed = _flushUpload(*pRec);
+	// Digest is checked before the upload is put in place
+	bool verified = flushed && _verifyUpload(request, *pRec);
+	File upFile = pRec->file;
+	size_t upLen = pRec->pos;
+	_uploadMRU = nullptr;
+	_uploads.remove_if([&](UploadRec const &r){
+		return r.req == &request;
+	});
+	if (!flushed) {
+		ESPWS_DEBUG("[%s] WARNING: Upload file write failed!\n",
+			request._remoteIdent.c_str());
+		request.send(500);
+		return;
+	}
+	if (upLen != request.contentLength()) {
 		ESPWS_DEBUG("[%s] WARNING: Upload content in-exact (expect %d, got %d)\n",
-			request._remoteIdent.c_str(), request.contentLength(), rec.pos);
+			request._remoteIdent.c_str(), request.contentLength(), upLen);
 		request.send(417);
 		return;
 	}
+	if (!verified) {
+		String upload_path = request.url().substring(path.length());
+		upload_path.concat(FC("._upload_"));
+		upFile.close();
+		_dir.remove(upload_path);
+		request.send(400);
+		return;
+	}
 	String upname = pathGetEntryName(request.url());
-	if (rec.file.rename(upname)) {
+	if (upFile.rename(upname)) {
+		_invalidatePath(request.url().substring(path.length()));
 		request.send(204);
 		return;
 	} else {
 		ESPWS_DEBUG("[%s] WARNING: Upload file rename failed '%s' -> '%s'\n",
 			request._remoteIdent.c_str(),
-			pathGetEntryName(rec.file.name()), upname.c_str());
+			pathGetEntryName(upFile.name()), upname.c_str());
 		request.send(500);
 		return;
 	}
 }
 
+void AsyncStaticWebHandler::_handleOptions(AsyncWebRequest &request) {
+	AsyncWebResponse * response = request.beginResponse(200);
+	response->addHeader(FC("Allow"), AsyncWebServer::mapMethods(method));
+#ifdef HANDLE_WEBDAV
+	if (method & HTTP_DAVEXT) {
+		response->addHeader(FC("DAV"), (method & HTTP_LOCK)? FC("1,2") : FC("1"));
+		response->addHeader(FC("MS-Author-Via"), FC("DAV"));
+	}
+#endif
+	response->addHeader(FC("Content-Length"), FC("0"));
+	request.send(response);
+}
+
 void AsyncStaticWebHandler::_handleDelete(AsyncWebRequest &request) {
 	String subpath = request.url().substring(path.length());
 
 	if (_dir.remove(subpath)) {
+		_invalidatePath(subpath);
 		request.send(204);
 		return;
 	} else {
@@ -652,4 +984,578 @@ void AsyncStaticWebHandler::_handleDelete(AsyncWebRequest &request) {
 	}
 }
 
+#ifdef HANDLE_WEBDAV
+
+bool AsyncStaticWebHandler::_checkContinueDAVList(AsyncWebRequest &request, bool continueHeader) {
+	// Infinite depth (also the default when absent) is not supported
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Depth"));
+	bool finiteDepth = false;
+	if (Header) {
+		for (auto const &value : Header->values) {
+			finiteDepth = value == "0" || value == "1";
+			break;
+		}
+	}
+	if (!finiteDepth) {
+		ESPWS_DEBUGVV("[%s] Unsupported PROPFIND depth\n", request._remoteIdent.c_str());
+		request.send(403);
+		return false;
+	}
+	return AsyncWebHandler::_checkContinue(request, continueHeader);
+}
+
+void AsyncStaticWebHandler::_handleDAVList(AsyncWebRequest &request) {
+	String subpath = request.url().substring(path.length());
+	bool listChildren = request.getHeader_P(PSTR_C("Depth"))->values.contains("1");
+
+	bool isDir = true;
+	size_t size = 0;
+	time_t mtime = 0;
+	if (subpath) {
+		String probePath = subpath;
+		if (probePath.end()[-1] == '/') probePath.remove(probePath.length()-1);
+		PathCacheRec const &PRec = _resolvePath(probePath);
+		if (PRec.flags & PATHREC_PLAIN) {
+			isDir = false;
+			size = PRec.meta[ENCODING_IDENTITY].size;
+			mtime = PRec.meta[ENCODING_IDENTITY].mtime;
+		} else if (!(PRec.flags & PATHREC_DIR)) {
+			ESPWS_DEBUGVV("[%s] Entry not found\n", request._remoteIdent.c_str());
+			request.send(404);
+			return;
+		}
+	}
+
+	Dir Children;
+	if (isDir && listChildren) {
+		Children = subpath? _dir.openDir(subpath) : _dir;
+		if (!Children) {
+			ESPWS_DEBUGV("[%s] Unable to locate dir '%s'\n",
+				request._remoteIdent.c_str(), subpath.c_str());
+			request.send(500);
+			return;
+		}
+	}
+	ESPWS_DEBUGV("[%s] PROPFIND '%s' (%s)\n", request._remoteIdent.c_str(),
+		request.url().c_str(), listChildren? "1" : "0");
+	request.send(new AsyncPropFindResponse(Children, isDir, size, mtime));
+}
+
+int AsyncStaticWebHandler::_getDAVDestination(AsyncWebRequest &request, String &subpath) {
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Destination"));
+	if (!Header) return 400;
+	String dest;
+	for (auto const &value : Header->values) {
+		dest = value;
+		break;
+	}
+	// Absolute URI must refer to this server
+	int authStart = dest.indexOf(FC("://"));
+	if (authStart >= 0) {
+		authStart+= 3;
+		int pathStart = dest.indexOf('/', authStart);
+		if (pathStart < 0) return 400;
+		String const &host = request.host();
+		if (pathStart - authStart != (int)host.length() ||
+			strncasecmp(dest.c_str() + authStart, host.c_str(), host.length()) != 0)
+			return 502;
+		dest.remove(0, pathStart);
+	}
+	String rawUrl = urlDecode(dest.c_str(), dest.length());
+	// Collapse repeated separators, and refuse dot segments,
+	//   which could escape the handler (and its ACLs)
+	String url;
+	url.reserve(rawUrl.length());
+	for (char c : rawUrl) {
+		if (c == '/' && url && url.end()[-1] == '/') continue;
+		url.concat(c);
+	}
+	for (char const *seg = url.c_str(); *seg;) {
+		char const *segEnd = strchr(seg, '/');
+		if (!segEnd) segEnd = seg + strlen(seg);
+		if (seg[0] == '.' && (segEnd == seg + 1 || (seg[1] == '.' && segEnd == seg + 2)))
+			return 400;
+		seg = *segEnd? segEnd + 1 : segEnd;
+	}
+	// Cross-handler transfers are not supported
+	if (!url.startsWith(path)) return 502;
+	subpath = url.substring(path.length());
+	if (subpath && subpath.end()[-1] == '/') subpath.remove(subpath.length()-1);
+	return subpath? 0 : 403;
+}
+
+bool AsyncStaticWebHandler::_checkContinueDAVCopy(AsyncWebRequest &request, bool continueHeader) {
+	String srcPath = request.url().substring(path.length());
+	if (srcPath && srcPath.end()[-1] == '/') srcPath.remove(srcPath.length()-1);
+	String dstPath;
+	int code = srcPath? _getDAVDestination(request, dstPath) : 403;
+	if (!code && dstPath == srcPath) code = 403;
+#ifdef HANDLE_AUTHENTICATION
+	// ACLs only covered the request URL, the destination is written like a PUT
+	if (!code && (!request.session() ||
+		request._server._checkACL(HTTP_PUT, path + dstPath, request.session()) != ACL_ALLOWED)) {
+		ESPWS_DEBUGV("[%s] Decline destination by ACL\n", request._remoteIdent.c_str());
+		code = 403;
+	}
+#endif
+	if (code) {
+		ESPWS_DEBUGVV("[%s] Unacceptable destination (%d)\n", request._remoteIdent.c_str(), code);
+		request.send(code);
+		return false;
+	}
+	if (request.method() == HTTP_MOVE && !_checkDAVLocks(request, srcPath, true)) return false;
+	if (!_checkDAVLocks(request, dstPath, false)) return false;
+	return AsyncWebHandler::_checkContinue(request, continueHeader);
+}
+
+void AsyncStaticWebHandler::_handleDAVCopy(AsyncWebRequest &request, bool move) {
+	String srcPath = request.url().substring(path.length());
+	if (srcPath.end()[-1] == '/') srcPath.remove(srcPath.length()-1);
+	String dstPath;
+	_getDAVDestination(request, dstPath);
+
+	PathCacheRec const &SRec = _resolvePath(srcPath);
+	if (!(SRec.flags & PATHREC_PLAIN)) {
+		if (SRec.flags & PATHREC_DIR) {
+			ESPWS_DEBUG("[%s] WARNING: Collection transfer not implemented\n",
+				request._remoteIdent.c_str());
+			request.send(501);
+		} else {
+			ESPWS_DEBUGVV("[%s] Entry not found\n", request._remoteIdent.c_str());
+			request.send(404);
+		}
+		return;
+	}
+
+	bool overwrite = true;
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Overwrite"));
+	if (Header) {
+		for (auto const &value : Header->values) {
+			overwrite = !value.equalsIgnoreCase(FC("F"));
+			break;
+		}
+	}
+	bool replace = _dir.exists(dstPath);
+	if (replace && (!overwrite || _dir.isDir(dstPath))) {
+		ESPWS_DEBUGVV("[%s] Cannot replace destination '%s'\n",
+			request._remoteIdent.c_str(), dstPath.c_str());
+		request.send(412);
+		return;
+	}
+	String dstParent = pathGetParent(dstPath);
+	if (dstParent && !_dir.isDir(dstParent)) {
+		ESPWS_DEBUGVV("[%s] Unsatisfied parent dir: '%s'\n",
+			request._remoteIdent.c_str(), dstParent.c_str());
+		request.send(409);
+		return;
+	}
+
+	if (move && pathGetParent(srcPath) == dstParent) {
+		// Same directory, just rename in place
+		if (replace && !_dir.remove(dstPath)) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to remove destination '%s'\n",
+				request._remoteIdent.c_str(), dstPath.c_str());
+			request.send(500);
+			return;
+		}
+		String dstName = pathGetEntryName(dstPath);
+		File Src = _dir.openFile(srcPath.c_str(), "r");
+		bool renamed = Src && Src.rename(dstName);
+		_invalidatePath(srcPath);
+		_invalidatePath(dstPath);
+		if (!renamed) {
+			ESPWS_DEBUG("[%s] WARNING: File rename failed '%s' -> '%s'\n",
+				request._remoteIdent.c_str(), srcPath.c_str(), dstName.c_str());
+			request.send(500);
+			return;
+		}
+		request.send(replace? 204 : 201);
+		return;
+	}
+
+	// Data is copied in steps from scheduler ticks, and the reply is sent when done
+	ESPWS_DEBUGV("[%s] %s '%s' -> '%s'\n", request._remoteIdent.c_str(),
+		SFPSTR(request.methodToString()), srcPath.c_str(), dstPath.c_str());
+	request.send(new AsyncFileCopyResponse(_dir, srcPath, dstPath, move, replace,
+		[this, srcPath, dstPath]() {
+			_invalidatePath(srcPath);
+			_invalidatePath(dstPath);
+		}));
+}
+
+void AsyncStaticWebHandler::_sweepLocks(void) {
+	uint32_t curTS = millis();
+	int32_t nextExpire = 0;
+	uint8_t idx = 0;
+	while (idx < _lockCnt) {
+		int32_t remain = _locks[idx].expire - curTS;
+		if (remain <= 0) {
+			ESPWS_DEBUGV("Lock expired '%s' (%s)\n", _locks[idx].path.c_str(), _locks[idx].token);
+			// Keep the table compact, order does not matter
+			if (idx != --_lockCnt) _locks[idx] = _locks[_lockCnt];
+			_locks[_lockCnt].path = String();
+			continue;
+		}
+		if (!nextExpire || remain < nextExpire) nextExpire = remain;
+		idx++;
+	}
+	os_timer_disarm(&_lockTimer);
+	if (nextExpire) os_timer_arm(&_lockTimer, nextExpire, false);
+}
+
+AsyncStaticWebHandler::LockRec* AsyncStaticWebHandler::_findLock(String const &subpath,
+	bool deep, char const *tokens) {
+	if (!_lockCnt) return nullptr;
+	// Hash the path incrementally, each ancestor is checked as its hash completes
+	uint32_t hash = 2166136261UL;
+	size_t len = subpath.length();
+	for (size_t i = 0; i <= len; i++) {
+		if (i == 0 || i == len || subpath[i] == '/') {
+			for (uint8_t idx = 0; idx < _lockCnt; idx++) {
+				LockRec &lock = _locks[idx];
+				if (lock.hash != hash || lock.path.length() != i) continue;
+				if (i != len && !lock.deep) continue;
+				if (strncmp(lock.path.c_str(), subpath.c_str(), i) != 0) continue;
+				if (tokens && strstr(tokens, lock.token)) continue;
+				return &lock;
+			}
+		}
+		if (i < len) hash = (hash ^ (uint8_t)subpath[i]) * 16777619UL;
+	}
+	if (deep) {
+		for (uint8_t idx = 0; idx < _lockCnt; idx++) {
+			LockRec &lock = _locks[idx];
+			if (lock.path.length() <= len) continue;
+			if (len && (lock.path[len] != '/' || !lock.path.startsWith(subpath))) continue;
+			if (tokens && strstr(tokens, lock.token)) continue;
+			return &lock;
+		}
+	}
+	return nullptr;
+}
+
+bool AsyncStaticWebHandler::_lockCovers(LockRec const &lock, String const &subpath) {
+	if (lock.path == subpath) return true;
+	if (!lock.deep) return false;
+	return !lock.path || (subpath.startsWith(lock.path) && subpath[lock.path.length()] == '/');
+}
+
+bool AsyncStaticWebHandler::_checkDAVLocks(AsyncWebRequest &request, String const &subpath, bool deep) {
+	if (!_lockCnt) return true;
+	// Submitted lock tokens are only looked for, the rest of the condition is not evaluated
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("If"));
+	String tokens;
+	if (Header) {
+		for (auto const &value : Header->values) tokens.concat(value);
+	}
+	LockRec *lock = _findLock(subpath, deep, tokens.c_str());
+	if (lock) {
+		ESPWS_DEBUGV("[%s] Locked by '%s' (%s)\n", request._remoteIdent.c_str(),
+			lock->path.c_str(), lock->token);
+		request.send(423);
+		return false;
+	}
+	return true;
+}
+
+void AsyncStaticWebHandler::_handleDAVLock(AsyncWebRequest &request) {
+	String subpath = request.url().substring(path.length());
+	if (subpath && subpath.end()[-1] == '/') subpath.remove(subpath.length()-1);
+
+	uint32_t timeout = STATIC_DAV_LOCKTIMEOUT;
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Timeout"));
+	if (Header) {
+		for (auto const &value : Header->values) {
+			// Only the first (most preferred) value is considered
+			uint32_t reqTimeout;
+			if (value.startsWith(FC("Second-")) &&
+				value.substring(7).toUInt(reqTimeout, 10) && reqTimeout) {
+				if (reqTimeout < timeout) timeout = reqTimeout;
+			}
+			break;
+		}
+	}
+
+	if (!request.contentLength() || request.contentLength() == -1) {
+		// Refresh an existing lock, identified by the submitted token
+		Header = request.getHeader_P(PSTR_C("If"));
+		if (Header) {
+			for (auto const &value : Header->values) {
+				for (uint8_t idx = 0; idx < _lockCnt; idx++) {
+					LockRec &lock = _locks[idx];
+					if (!strstr(value.c_str(), lock.token)) continue;
+					if (!_lockCovers(lock, subpath)) continue;
+					lock.expire = millis() + timeout * 1000;
+					_sweepLocks();
+					ESPWS_DEBUGV("[%s] Lock refreshed '%s' (%s)\n", request._remoteIdent.c_str(),
+						lock.path.c_str(), lock.token);
+					_sendLockInfo(request, 200, lock, false);
+					return;
+				}
+			}
+		}
+		ESPWS_DEBUGVV("[%s] No lock to refresh\n", request._remoteIdent.c_str());
+		request.send(412);
+		return;
+	}
+
+	bool deep = true;
+	Header = request.getHeader_P(PSTR_C("Depth"));
+	if (Header) {
+		for (auto const &value : Header->values) {
+			if (value == "0") deep = false;
+			else if (!value.equalsIgnoreCase(FC("infinity"))) {
+				request.send(400);
+				return;
+			}
+			break;
+		}
+	}
+	if (_findLock(subpath, deep)) {
+		ESPWS_DEBUGV("[%s] Lock conflict on '%s'\n", request._remoteIdent.c_str(),
+			subpath.c_str());
+		request.send(423);
+		return;
+	}
+	if (_lockCnt >= STATIC_DAV_LOCKMAX) {
+		ESPWS_DEBUG("[%s] WARNING: Lock table full\n", request._remoteIdent.c_str());
+		request.send(503);
+		return;
+	}
+
+	// Locking an unmapped path creates an empty file
+	int code = 200;
+	if (subpath && !_dir.exists(subpath)) {
+		String ParentPath = pathGetParent(subpath);
+		if (ParentPath && !_dir.isDir(ParentPath)) {
+			ESPWS_DEBUGVV("[%s] Unsatisfied parent dir: '%s'\n",
+				request._remoteIdent.c_str(), ParentPath.c_str());
+			request.send(409);
+			return;
+		}
+		File Empty = _dir.openFile(subpath.c_str(), "w");
+		if (!Empty) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to create file '%s'\n",
+				request._remoteIdent.c_str(), subpath.c_str());
+			request.send(500);
+			return;
+		}
+		Empty.close();
+		_invalidatePath(subpath);
+		code = 201;
+	}
+
+	LockRec &lock = _locks[_lockCnt++];
+	lock.hash = 2166136261UL;
+	for (char c : subpath) lock.hash = (lock.hash ^ (uint8_t)c) * 16777619UL;
+	lock.expire = millis() + timeout * 1000;
+	lock.deep = deep;
+	lock.path = subpath;
+	// Random (version 4) UUID
+	uint32_t rnd[4];
+	for (uint8_t i = 0; i < 4; i++) rnd[i] = os_random();
+	rnd[1] = (rnd[1] & 0xFFFF0FFF) | 0x00004000;
+	rnd[2] = (rnd[2] & 0x3FFFFFFF) | 0x80000000;
+	snprintf_P(lock.token, sizeof(lock.token), PSTR_C("%08x-%04x-%04x-%04x-%04x%08x"),
+		rnd[0], rnd[1] >> 16, rnd[1] & 0xFFFF, rnd[2] >> 16, rnd[2] & 0xFFFF, rnd[3]);
+	_sweepLocks();
+	ESPWS_DEBUGV("[%s] Lock granted '%s' (%s), %us\n", request._remoteIdent.c_str(),
+		subpath.c_str(), lock.token, timeout);
+	_sendLockInfo(request, code, lock, true);
+}
+
+void AsyncStaticWebHandler::_handleDAVUnlock(AsyncWebRequest &request) {
+	String subpath = request.url().substring(path.length());
+	if (subpath && subpath.end()[-1] == '/') subpath.remove(subpath.length()-1);
+
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("Lock-Token"));
+	if (!Header) {
+		request.send(400);
+		return;
+	}
+	for (auto const &value : Header->values) {
+		for (uint8_t idx = 0; idx < _lockCnt; idx++) {
+			LockRec &lock = _locks[idx];
+			if (!strstr(value.c_str(), lock.token)) continue;
+			// The lock must cover the request URL
+			if (!_lockCovers(lock, subpath)) break;
+			ESPWS_DEBUGV("[%s] Lock released '%s' (%s)\n", request._remoteIdent.c_str(),
+				lock.path.c_str(), lock.token);
+			lock.expire = millis();
+			_sweepLocks();
+			request.send(204);
+			return;
+		}
+		break;
+	}
+	ESPWS_DEBUGVV("[%s] Lock token not applicable\n", request._remoteIdent.c_str());
+	request.send(409);
+}
+
+void AsyncStaticWebHandler::_sendLockInfo(AsyncWebRequest &request, int code,
+	LockRec const &lock, bool newLock) {
+	String LockToken(FC("opaquelocktoken:"));
+	LockToken.concat(lock.token);
+	int32_t remain = lock.expire - millis();
+
+	String Body(FC("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+		"<D:prop xmlns:D=\"DAV:\"><D:lockdiscovery><D:activelock>"
+		"<D:locktype><D:write/></D:locktype><D:lockscope><D:exclusive/></D:lockscope><D:depth>"));
+	Body.concat(lock.deep? FC("infinity") : FC("0"));
+	Body.concat(FC("</D:depth><D:timeout>Second-"));
+	Body.concat(remain > 0? remain / 1000 : 0);
+	Body.concat(FC("</D:timeout><D:locktoken><D:href>"));
+	Body.concat(LockToken);
+	Body.concat(FC("</D:href></D:locktoken><D:lockroot><D:href>"));
+	Body.concat(path);
+	for (char c : lock.path) {
+		if (isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~') {
+			Body.concat(c);
+		} else {
+			Body.concat('%');
+			Body.concat(HexLookup_UC[(c >> 4) & 0xF]);
+			Body.concat(HexLookup_UC[c & 0xF]);
+		}
+	}
+	Body.concat(FC("</D:href></D:lockroot></D:activelock></D:lockdiscovery></D:prop>"));
+
+	AsyncWebResponse *response = request.beginResponse(code, std::move(Body),
+		FC("application/xml; charset=utf-8"));
+	if (newLock) response->addHeader(FC("Lock-Token"), String('<') + LockToken + '>');
+	request.send(response);
+}
+
+#endif
+
 #endif
+
+/*
+ * Asset pack handler
+ * */
+
+static uint32_t _packHash(char const *str) {
+	uint32_t hash = 2166136261UL;
+	while (*str) hash = (hash ^ (uint8_t)*str++) * 16777619UL;
+	return hash;
+}
+
+AsyncPackWebHandler::AsyncPackWebHandler(String const &path, PGM_VOID_P pack)
+	: AsyncPathURIWebHandler(path, HTTP_GET | HTTP_HEAD)
+	, _pack((uint8_t const*)pack)
+	, _bucketCount(0)
+{
+	PackHead Head;
+	memcpy_P(&Head, _pack, sizeof(PackHead));
+	if (Head.magic != WEBPACK_MAGIC) {
+		ESPWS_LOG("ERROR: Invalid asset pack @%p\n", pack);
+		return;
+	}
+	_bucketCount = Head.bucketCount;
+	ESPWS_DEBUGV("Asset pack @%p: %d entries, %d buckets\n", pack,
+		Head.entryCount, _bucketCount);
+}
+
+bool AsyncPackWebHandler::_lookup(char const *name, PackEntry &entry) const {
+	if (!_bucketCount) return false;
+	uint32_t hash = _packHash(name);
+	uint16_t const *Buckets = (uint16_t const*)(_pack + sizeof(PackHead));
+	uint16_t bucket = hash & (_bucketCount - 1);
+	uint16_t idx = pgm_read_word(Buckets + bucket);
+	uint16_t end = pgm_read_word(Buckets + bucket + 1);
+	// Entries start at the next 4-byte boundary after bucket indices
+	size_t entryOfs = (sizeof(PackHead) + (_bucketCount + 1) * sizeof(uint16_t) + 3) & ~3;
+	PackEntry const *Entries = (PackEntry const*)(_pack + entryOfs);
+	for (; idx < end; idx++) {
+		memcpy_P(&entry, Entries + idx, sizeof(PackEntry));
+		if (entry.hash == hash && strcmp_P(name, (PGM_P)_pack + entry.nameOfs) == 0)
+			return true;
+	}
+	return false;
+}
+
+uint8_t AsyncPackWebHandler::_lookupVariants(String const &subpath, PackEntry *entries) const {
+	// An entry only counts as the variant its name suggests, so that
+	// e.g. a packed "app.js.gz" is never served as identity "app.js.gz"
+	uint8_t found = 0;
+	if (_lookup(subpath.c_str(), entries[ENCODING_IDENTITY])
+		&& entries[ENCODING_IDENTITY].encoding == ENCODING_IDENTITY)
+		found|= 1 << ENCODING_IDENTITY;
+	String encPath = subpath;
+	encPath.concat(".gz", 3);
+	if (_lookup(encPath.c_str(), entries[ENCODING_GZIP])
+		&& entries[ENCODING_GZIP].encoding == ENCODING_GZIP)
+		found|= 1 << ENCODING_GZIP;
+	encPath.end()[-2] = 'b';
+	encPath.end()[-1] = 'r';
+	if (_lookup(encPath.c_str(), entries[ENCODING_BROTLI])
+		&& entries[ENCODING_BROTLI].encoding == ENCODING_BROTLI)
+		found|= 1 << ENCODING_BROTLI;
+	return found;
+}
+
+String AsyncPackWebHandler::_subPath(AsyncWebRequest const &request) const {
+	String Ret = request.url().substring(path.length());
+	if (!Ret || Ret.end()[-1] == '/') Ret.concat(_indexFile);
+	return Ret;
+}
+
+bool AsyncPackWebHandler::_canHandle(AsyncWebRequest const &request) {
+	if (!AsyncPathURIWebHandler::_canHandle(request)) return false;
+	// Leave requests for assets not in the pack to other handlers
+	if (request.url().length() < path.length()) return true;
+	PackEntry Entries[ENCODING_COUNT];
+	return _lookupVariants(_subPath(request), Entries);
+}
+
+bool AsyncPackWebHandler::_isInterestingHeader(AsyncWebRequest const &request, String const &key) {
+	return key.equalsIgnoreCase(FC("If-None-Match"));
+}
+
+void AsyncPackWebHandler::_handleRequest(AsyncWebRequest &request) {
+	PackEntry Entries[ENCODING_COUNT];
+	uint8_t found = _lookupVariants(_subPath(request), Entries);
+
+	uint16_t qvals[ENCODING_COUNT];
+	parseAcceptEncoding(request.acceptEncoding().c_str(), qvals);
+	// Smaller variants are preferred, unless the client says otherwise
+	static uint8_t const encOrder[] = {ENCODING_BROTLI, ENCODING_GZIP, ENCODING_IDENTITY};
+	uint8_t sel = ENCODING_COUNT;
+	for (uint8_t enc : encOrder) {
+		if (!(found & (1 << enc)) || !qvals[enc]) continue;
+		if (sel == ENCODING_COUNT || qvals[enc] > qvals[sel]) sel = enc;
+	}
+	if (sel == ENCODING_COUNT) {
+		ESPWS_DEBUGVV("[%s] No acceptable variant\n", request._remoteIdent.c_str());
+		request.send((found & (1 << ENCODING_IDENTITY))? 406 : 404);
+		return;
+	}
+	PackEntry const &Entry = Entries[sel];
+
+	AsyncWebHeader const* Header = request.getHeader_P(PSTR_C("If-None-Match"));
+	if (Header) {
+		char ETag[32];
+		strncpy_P(ETag, (PGM_P)_pack + Entry.etagOfs, sizeof(ETag));
+		ETag[sizeof(ETag)-1] = '\0';
+		for (auto const &value : Header->values) {
+			if (matchETagList(value.c_str(), ETag)) {
+				ESPWS_DEBUGVV("[%s] Not modified\n", request._remoteIdent.c_str());
+				AsyncWebResponse * response = request.beginResponse(304);
+				response->addHeader(FC("ETag"), ETag);
+				if (_cache_control)
+					response->addHeader(FC("Cache-Control"), _cache_control);
+				if (found & ~(1 << ENCODING_IDENTITY))
+					response->addHeader(FC("Vary"), FC("Accept-Encoding"));
+				request.send(response);
+				return;
+			}
+		}
+	}
+
+	ESPWS_DEBUGVV("[%s] Serving pack entry '%s'\n", request._remoteIdent.c_str(),
+		SFPSTR((PGM_P)_pack + Entry.nameOfs));
+	AsyncWebResponse * response = new AsyncPackResponse(200,
+		(PGM_P)_pack + Entry.bodyOfs, Entry.bodyLen, (PGM_P)_pack + Entry.headOfs);
+	if (_cache_control)
+		response->addHeader(FC("Cache-Control"), _cache_control);
+	request.send(response);
+}
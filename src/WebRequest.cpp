@@ -32,45 +32,219 @@ extern "C" {
 	#include "user_interface.h"
 }
 
-String urlDecode(char const *buf, size_t len) {
-	char temp[3];
-	temp[2] = '\0';
+// Hex digit values, indexed from '0' to 'f'
+static int8_t const HexValue[] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1,
+	10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	10, 11, 12, 13, 14, 15
+};
+
+int8_t hexDigitValue(char c) {
+	uint8_t idx = c - '0';
+	return idx < sizeof(HexValue)? HexValue[idx] : -1;
+}
+
+// SWAR helpers, test four characters at a time
+#define WORD_REPEAT(c) ((uint8_t)(c) * 0x01010101UL)
+#define WORD_HASZERO(v) (((v) - 0x01010101UL) & ~(v) & 0x80808080UL)
+
+// Length of the leading run that needs no decoding
+static size_t urlPlainRun(char const *src, size_t len) {
+	char const *ptr = src;
+	char const *end = src + len;
+	// Word loads must be aligned on Xtensa
+	while (ptr < end && ((uintptr_t)ptr & 3)) {
+		if (*ptr == '%' || *ptr == '+') return ptr - src;
+		ptr++;
+	}
+	while (end - ptr >= 4) {
+		uint32_t word;
+		memcpy(&word, __builtin_assume_aligned(ptr, 4), 4);
+		if (WORD_HASZERO(word ^ WORD_REPEAT('%')) | WORD_HASZERO(word ^ WORD_REPEAT('+'))) break;
+		ptr+= 4;
+	}
+	while (ptr < end && *ptr != '%' && *ptr != '+') ptr++;
+	return ptr - src;
+}
+
+// Decoded text never grows, so dst may be the same as src
+static size_t urlDecodeTo(char *dst, char const *src, size_t len) {
+	char *out = dst;
+	char const *end = src + len;
+	while (src < end) {
+		size_t run = urlPlainRun(src, end - src);
+		if (run) {
+			// Nothing to move when decoding in place, until the first escape
+			if (out != src) memmove(out, src, run);
+			out+= run;
+			src+= run;
+			if (src == end) break;
+		}
+		char c = *src++;
+		if (c == '%' && end - src >= 2) {
+			int8_t hi = hexDigitValue(src[0]);
+			int8_t lo = hexDigitValue(src[1]);
+			// Malformed escapes are kept as-is
+			if ((hi | lo) >= 0) {
+				c = (hi << 4) | lo;
+				src+= 2;
+			}
+		} else if (c == '+') c = ' ';
+		*out++ = c;
+	}
+	return out - dst;
+}
 
+String urlDecode(char const *buf, size_t len) {
 	String Ret;
-	Ret.reserve(len);
-	while (*buf){
-		if ((*buf == '%') && buf[1] && buf[2]){
-			temp[0] = *++buf;
-			temp[1] = *++buf;
-			Ret.concat((char)strtol(temp, nullptr, 16));
-		} else if (*buf == '+') {
-			Ret.concat(' ');
-		} else {
-			Ret.concat(*buf);  // normal ascii char
-		}
-		buf++;
+	// Decoded text is at most as long, and most text has no escapes at all
+	Ret.concat(buf, len);
+	size_t run = urlPlainRun(buf, len);
+	if (run < len) {
+		char *str = Ret.begin();
+		Ret.remove(run + urlDecodeTo(str + run, str + run, len - run));
 	}
 	return Ret;
 }
 
+// Bitmap of characters that need no escaping (ASCII alphanumerics and "-_.~")
+static uint8_t const UrlUnreserved[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0xFF, 0x03,
+	0xFE, 0xFF, 0xFF, 0x87, 0xFE, 0xFF, 0xFF, 0x47
+};
+
+static inline bool urlUnreserved(char c) {
+	uint8_t idx = c;
+	return idx < 128 && (UrlUnreserved[idx >> 3] & (1 << (idx & 7)));
+}
+
 String urlEncode(char const *buf, size_t len) {
+	char const *end = buf + len;
+	// Escapes take three characters, space becomes '+'
+	size_t outLen = len;
+	for (char const *ptr = buf; ptr < end; ptr++)
+		if (!urlUnreserved(*ptr) && *ptr != ' ') outLen+= 2;
+
 	String Ret;
-	Ret.reserve(len);
-	while (*buf){
-		if (isalnum(*buf) || *buf == '-' || *buf == '_' || *buf == '.' || *buf == '~') {
-			Ret.concat(*buf);  // normal ascii char
-		} else if (*buf == ' ') {
+	Ret.reserve(outLen);
+	while (buf < end) {
+		char const *run = buf;
+		while (buf < end && urlUnreserved(*buf)) buf++;
+		if (buf > run) Ret.concat(run, buf - run);
+		if (buf == end) break;
+
+		char c = *buf++;
+		if (c == ' ') {
 			Ret.concat('+');
 		} else {
-			Ret.concat('%');
-			Ret.concat(HexLookup_UC[(*buf >> 4) & 0xF]);
-			Ret.concat(HexLookup_UC[(*buf >> 0) & 0xF]);
+			char esc[3] = {'%', HexLookup_UC[(c >> 4) & 0xF], HexLookup_UC[c & 0xF]};
+			Ret.concat(esc, 3);
 		}
-		buf++;
 	}
 	return Ret;
 }
 
+void parseAcceptEncoding(char const *str, uint16_t *qvals) {
+	int16_t starQ = -1;
+	uint8_t explicitSet = 0;
+	while (*str) {
+		while (*str == ' ' || *str == '\t' || *str == ',') str++;
+		if (!*str) break;
+		char const *name = str;
+		while (*str && *str != ',' && *str != ';' && *str != ' ' && *str != '\t') str++;
+		size_t nameLen = str - name;
+
+		uint16_t q = 1000;
+		while (*str && *str != ',') {
+			if (*str++ != ';') continue;
+			while (*str == ' ' || *str == '\t') str++;
+			if ((*str != 'q' && *str != 'Q') || str[1] != '=') continue;
+			str+= 2;
+			q = (*str == '1')? 1000 : 0;
+			if (*str != '0' && *str != '1') continue;
+			if (*++str != '.') continue;
+			uint16_t scale = 100;
+			while (isdigit(*++str)) {
+				if (q < 1000) q+= (*str - '0') * scale;
+				scale/= 10;
+			}
+		}
+
+		auto isName = [&](PGM_P n) {
+			return nameLen == strlen_P(n) && strncasecmp_P(name, n, nameLen) == 0;
+		};
+		int8_t enc = -1;
+		if (nameLen == 1 && *name == '*') starQ = q;
+		else if (isName(PSTR_C("identity"))) enc = ENCODING_IDENTITY;
+		else if (isName(PSTR_C("gzip")) || isName(PSTR_C("x-gzip"))) enc = ENCODING_GZIP;
+		else if (isName(PSTR_C("br"))) enc = ENCODING_BROTLI;
+		if (enc >= 0) {
+			qvals[enc] = q;
+			explicitSet|= 1 << enc;
+		}
+	}
+	// Unlisted codings fall back to "*", identity is acceptable unless excluded
+	for (int enc = 0; enc < ENCODING_COUNT; enc++) {
+		if (explicitSet & (1 << enc)) continue;
+		qvals[enc] = starQ >= 0? starQ : (enc == ENCODING_IDENTITY? 1000 : 0);
+	}
+}
+
+size_t printHTTPDate(time_t ts, char *buf, size_t len) {
+	struct tm tm;
+	gmtime_r(&ts, &tm);
+	// Note: format string must stay in RAM, strftime reads it byte-wise
+	return strftime(buf, len, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+time_t parseHTTPDate(char const *str) {
+	// Only IMF-fixdate is recognized, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+	char const *ptr = strchr(str, ',');
+	if (!ptr) return -1;
+	int day, year, hour, min, sec;
+	char mon[4];
+	if (sscanf(ptr+1, " %2d %3s %4d %2d:%2d:%2d", &day, mon, &year, &hour, &min, &sec) != 6)
+		return -1;
+	int month = 0;
+	while (month < 12 && strncmp_P(mon, PSTR_C("JanFebMarAprMayJunJulAugSepOctNovDec")+month*3, 3))
+		month++;
+	if (month++ >= 12 || year < 1970 || day < 1 || day > 31) return -1;
+
+	// Days since epoch (proleptic Gregorian calendar)
+	if (month <= 2) year--;
+	int era = year / 400;
+	unsigned yoe = year - era * 400;
+	unsigned doy = (153 * (month > 2? month-3 : month+9) + 2) / 5 + day - 1;
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	long days = era * 146097L + (long)doe - 719468;
+	return (time_t)days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+size_t printFileETag(size_t size, time_t mtime, char *buf, size_t len) {
+	return snprintf_P(buf, len, PSTR_C("\"%u@%lx\""), size, (unsigned long)mtime);
+}
+
+bool matchETagList(char const *list, char const *etag) {
+	if (etag[0] == 'W' && etag[1] == '/') etag+= 2;
+	size_t etagLen = strlen(etag);
+	while (*list) {
+		while (*list == ' ' || *list == '\t' || *list == ',') list++;
+		if (!*list) break;
+		if (*list == '*') return true;
+		if (list[0] == 'W' && list[1] == '/') list+= 2;
+		char const *tagEnd = list;
+		if (*tagEnd == '"') {
+			tagEnd = strchr(tagEnd+1, '"');
+			if (!tagEnd) break;
+			tagEnd++;
+		} else while (*tagEnd && *tagEnd != ',') tagEnd++;
+		if ((size_t)(tagEnd - list) == etagLen && memcmp(list, etag, etagLen) == 0) return true;
+		list = tagEnd;
+	}
+	return false;
+}
+
 #define SCHED_RES       10
 #define SCHED_MAXSHARE  TCP_SND_BUF
 // Minimal heap available before scheduling a response processing
@@ -185,15 +359,19 @@ AsyncWebRequest::AsyncWebRequest(AsyncWebServer const &s, AsyncClient &c,
 	//, _url()
 	//, _host()
 	//, _contentType()
+	, _queryCnt(-1)
 	, _contentLength(-1)
+#ifdef HANDLE_REQUEST_CONTENT
+	, _chunked(false)
+#endif
 #ifdef HANDLE_AUTHENTICATION
 	, _session(nullptr)
 #endif
 	, _headers(nullptr)
-	, _queries(nullptr)
 #ifdef HANDLE_REQUEST_CONTENT
 #if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
 	, _params(nullptr)
+	, _queryParams(false)
 #endif
 #ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
 	, _uploads(nullptr)
@@ -268,14 +446,20 @@ void AsyncWebRequest::_cleanup(uint8_t stages) {
 		_contentType.clear(true);
 		_oUrl.clear(true);
 		_oQuery.clear(true);
+		_queryBuf.clear(true);
+		_queryCnt = -1;
+		_queryIndex.clear();
 		_headers.clear();
-		_queries.clear();
+		_headerIndex.clear();
 #ifdef HANDLE_REQUEST_CONTENT
 	#if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
 		_params.clear();
+		_paramIndex.clear();
+		_queryParams = false;
 	#endif
 	#ifdef HANDLE_REQUEST_CONTENT_MULTIPARTFORM
 		_uploads.clear();
+		_uploadIndex.clear();
 	#endif
 #endif
 	}
@@ -324,6 +508,9 @@ void AsyncWebRequest::_recycleClient(void) {
 
 	_method = HTTP_NONE;
 	_contentLength = -1;
+#ifdef HANDLE_REQUEST_CONTENT
+	_chunked = false;
+#endif
 	_lastDiscardTS = 0;
 	_state = REQUEST_SETUP;
 	// Note: the following two fields are the reasons we are here, so no need to touch
@@ -465,43 +652,67 @@ void AsyncWebRequest::_setUrl(String && url) {
 	int indexQuery = url.indexOf('?');
 	if (indexQuery > 0){
 		_oQuery = &url[indexQuery];
-		_parseQueries(&url[indexQuery+1]);
 		url.remove(indexQuery);
-	} else {
-		_queries.clear();
-		_oQuery.clear(true);
-	}
+	} else _oQuery.clear(true);
+	// Queries are only parsed when asked for
+	_queryBuf.clear(true);
+	_queryCnt = -1;
+	_queryIndex.clear();
+#ifdef HANDLE_REQUEST_CONTENT
+#if defined(HANDLE_REQUEST_CONTENT_SIMPLEFORM) || defined(HANDLE_REQUEST_CONTENT_MULTIPARTFORM)
+	_queryParams = false;
+#endif
+#endif
 	_url = urlDecode(url.c_str(), url.length());
 	_oUrl = std::move(url);
 }
 
-void AsyncWebRequest::_parseQueries(char *buf){
-	_queries.clear();
+void AsyncWebRequest::_parseQueries(void) const {
+	_queryCnt = 0;
+	if (_oQuery.length() <= 1) return;
 
-	while (*buf){
-		char *name = buf;
-		while (*buf != '&')
-			if (*buf) buf++;
-			else break;
-		if (name == buf) {
-			buf++;
-			continue;
+	// Pairs are decoded in place, and each name and value is NUL terminated.
+	// A pair may decode one byte longer than its source (with separator), so
+	//   the source is placed behind a gap of one byte per pair, plus one
+	size_t len = _oQuery.length() - 1;
+	char const *src = _oQuery.begin() + 1;
+	size_t gap = 2;
+	for (char const *c = src; (c = (char const*)memchr(c, '&', src + len - c)); c++) gap++;
+	if (!_queryBuf.reserve(len + gap)) {
+		ESPWS_LOG("[%s] ERROR: Unable to allocate query buffer\n", _remoteIdent.c_str());
+		return;
+	}
+	_queryBuf.concat(src, len);
+	char *out = _queryBuf.begin();
+	char *buf = out + gap;
+	memmove(buf, out, len);
+	char *end = buf + len;
+	while (buf < end) {
+		char *sep = (char*)memchr(buf, '&', end - buf);
+		if (!sep) sep = end;
+		if (sep != buf) {
+			char *eq = (char*)memchr(buf, '=', sep - buf);
+			if (!eq) eq = sep;
+			ESPWS_DEBUGVVDO(char const *name = out);
+			out+= urlDecodeTo(out, buf, eq - buf);
+			*out++ = '\0';
+			ESPWS_DEBUGVVDO(char const *value = out);
+			if (eq < sep) out+= urlDecodeTo(out, eq + 1, sep - eq - 1);
+			*out++ = '\0';
+			ESPWS_DEBUGVV("[%s] Query [%s] = '%s'\n", _remoteIdent.c_str(), name, value);
+			_queryCnt++;
+		}
+		buf = sep + 1;
+	}
+
+	if (_queryCnt > REQUEST_INDEX_MIN) {
+		// Later occurrence overrides
+		buf = _queryBuf.begin();
+		for (size_t i = 0; i < _queryCnt; i++) {
+			if (!_queryIndex.add(buf, true)) break;
+			buf+= strlen(buf) + 1;
+			buf+= strlen(buf) + 1;
 		}
-		if (*buf) *buf++ = '\0';
-
-		char *value = name;
-		while (*value != '=')
-			if (*value) value++;
-			else break;
-		if (*value) *value++ = '\0';
-
-		String _name = urlDecode(name,value-name);
-		String _value = urlDecode(value,buf-value);
-		ESPWS_DEBUGVV("[%s] Query [%s] = '%s'\n",
-			_remoteIdent.c_str(), _name.c_str(), _value.c_str());
-		if (_name.endsWith("[]",2,0,false)) {
-			_params.append(AsyncWebParam(std::move(_name), std::move(_value)));
-		} else _addUniqueNameVal(_queries, _name, _value);
 	}
 }
 
@@ -510,19 +721,52 @@ bool AsyncWebRequest::hasHeader(String const &name) const {
 }
 
 AsyncWebHeader const* AsyncWebRequest::getHeader(String const &name) const {
+	if (_headerIndex.built()) return _headerIndex.find(name.c_str());
 	return _headers.get_if([&](AsyncWebHeader const &v) {
 		return name.equalsIgnoreCase(v.name);
 	});
 }
 
-bool AsyncWebRequest::hasQuery(String const &name) const {
-	return getQuery(name) != nullptr;
+AsyncWebHeader const* AsyncWebRequest::getHeader_P(PGM_P name) const {
+	if (_headerIndex.built()) {
+		char buf[REQUEST_PARAM_KEYMAX];
+		strncpy_P(buf, name, sizeof(buf) - 1);
+		buf[sizeof(buf) - 1] = '\0';
+		return _headerIndex.find(buf);
+	}
+	return _headers.get_if([&](AsyncWebHeader const &v) {
+		return strcasecmp_P(v.name.c_str(), name) == 0;
+	});
 }
 
-AsyncWebQuery const* AsyncWebRequest::getQuery(String const &name) const {
-	return _queries.get_if([&](AsyncWebQuery const &v) {
-		return name == v.name;
+size_t AsyncWebRequest::queries(void) const {
+	if (_queryCnt == -1) _parseQueries();
+	return _queryCnt;
+}
+
+AsyncWebQuery AsyncWebRequest::getQuery(String const &name) const {
+	if (_queryCnt == -1) _parseQueries();
+	if (_queryIndex.built()) {
+		char const *key = _queryIndex.find(name.c_str());
+		return key? AsyncWebQuery(key, key + strlen(key) + 1) : AsyncWebQuery();
+	}
+
+	AsyncWebQuery Ret;
+	enumQueries([&](AsyncWebQuery const &v) {
+		if (name == v.name) Ret = v;
+		return false;
 	});
+	return Ret;
+}
+
+void AsyncWebRequest::enumQueries(std::function<bool(AsyncWebQuery const&)> const& Pred) const {
+	if (_queryCnt == -1) _parseQueries();
+	char const *buf = _queryBuf.begin();
+	for (size_t i = 0; i < _queryCnt; i++) {
+		AsyncWebQuery Query(buf, buf + strlen(buf) + 1);
+		buf = Query.value + strlen(Query.value) + 1;
+		if (Pred(Query)) break;
+	}
 }
 
 #ifdef HANDLE_REQUEST_CONTENT
@@ -532,7 +776,22 @@ bool AsyncWebRequest::hasParam(String const &name) const {
 	return getParam(name) != nullptr;
 }
 
+void AsyncWebRequest::_addQueryParams(void) const {
+	if (_queryParams) return;
+	_queryParams = true;
+	enumQueries([&](AsyncWebQuery const &v) {
+		size_t nameLen = strlen(v.name);
+		if (nameLen >= 2 && v.name[nameLen-2] == '[' && v.name[nameLen-1] == ']') {
+			_params.append(AsyncWebParam(String(v.name), String(v.value)));
+			_paramIndex.append(_params, _params.back());
+		}
+		return false;
+	});
+}
+
 AsyncWebParam const* AsyncWebRequest::getParam(String const &name) const {
+	_addQueryParams();
+	if (_paramIndex.built()) return _paramIndex.find(name.c_str());
 	return _params.get_if([&](AsyncWebParam const &v) {
 		return name == v.name;
 	});
@@ -545,6 +804,7 @@ bool AsyncWebRequest::hasUpload(String const &name) const {
 }
 
 AsyncWebUpload const* AsyncWebRequest::getUpload(String const &name) const {
+	if (_uploadIndex.built()) return _uploadIndex.find(name.c_str());
 	return _uploads.get_if([&](AsyncWebUpload const &v) {
 		return name == v.name;
 	});
@@ -124,28 +124,23 @@ bool AsyncRequestHeadParser::_parseLine(void) {
 							_rejectAuth(nullptr);
 						return false;
 					}
+#endif
+#ifdef HANDLE_REQUEST_CONTENT
+					// Transfer coding takes precedence over content length
+					if (_request.chunked()) __setContentLength(-1);
 #endif
 					// Check if we can continue
 					if (__reqHandler()->_checkContinue(_request, _expectingContinue)) {
 #ifdef HANDLE_REQUEST_CONTENT
 						size_t bodyLength = _request.contentLength();
-						if (bodyLength != -1 && bodyLength) {
+						if (_request.chunked()) {
+							ESPWS_DEBUGVV("[%s] Using chunked body decoder\n",
+								_request._remoteIdent.c_str());
+							__reqParser(new AsyncRequestChunkedContentParser(_request));
+							__reqState(REQUEST_BODY);
+						} else if (bodyLength != -1 && bodyLength) {
 							// Switch parser
-							AsyncWebParser* newParser = nullptr;
-							for (auto& item : BodyParserRegistry) {
-								if (newParser = item(_request)) break;
-							}
-							ESPWS_DEBUGVVDO({
-								if (newParser) {
-									ESPWS_LOG("[%s] Using registered body parser\n",
-										_request._remoteIdent.c_str());
-								} else {
-									ESPWS_LOG("[%s] Using generic body parser\n",
-										_request._remoteIdent.c_str());
-								}
-							});
-							__reqParser(newParser? newParser
-								: new AsyncRequestPassthroughContentParser(_request));
+							__reqParser(makeBodyParser(_request));
 							__reqState(REQUEST_BODY);
 						} else
 #endif
@@ -287,6 +282,17 @@ bool AsyncRequestHeadParser::_parseReqHeader(void) {
 		__setContentLength(contentLength);
 		ESPWS_DEBUGV("[%s] + Content-Length: %d\n",
 			_request._remoteIdent.c_str(), _request.contentLength());
+#ifdef HANDLE_REQUEST_CONTENT
+	} else if (_temp.equalsIgnoreCase(FC("Transfer-Encoding"))) {
+		ESPWS_DEBUGV("[%s] + Transfer-Encoding: '%s'\n",
+			_request._remoteIdent.c_str(), value.c_str());
+		// Other codings (or stacking) are not supported
+		if (!value.equalsIgnoreCase(FC("chunked"))) {
+			_request.send_P(501, PSTR_C("Unsupported 'Transfer-Encoding' header value"), FC("text/plain"));
+			return false;
+		}
+		__setChunked(true);
+#endif
 	} else if (_temp.equalsIgnoreCase(FC("Expect"))) {
 		ESPWS_DEBUGV("[%s] + Expect: '%s'\n", _request._remoteIdent.c_str(), value.c_str());
 		if (value.equalsIgnoreCase(FC("100-continue"))) {
@@ -392,6 +398,134 @@ void AsyncRequestHeadParser::_rejectAuth(AuthSession *session) {
 
 #ifdef HANDLE_REQUEST_CONTENT
 
+AsyncWebParser* makeBodyParser(AsyncWebRequest &request) {
+	for (auto& item : BodyParserRegistry) {
+		AsyncWebParser* newParser = item(request);
+		if (newParser) {
+			ESPWS_DEBUGVV("[%s] Using registered body parser\n", request._remoteIdent.c_str());
+			return newParser;
+		}
+	}
+	ESPWS_DEBUGVV("[%s] Using generic body parser\n", request._remoteIdent.c_str());
+	return new AsyncRequestPassthroughContentParser(request);
+}
+
+ESPWS_DEBUGDO(PGM_P AsyncRequestChunkedContentParser::_stateToString(void) const {
+	switch (_state) {
+		case C_PARSER_SIZE: return PSTR_C("ChunkSize");
+		case C_PARSER_DATA: return PSTR_C("ChunkData");
+		case C_PARSER_DATAEND: return PSTR_C("ChunkEnd");
+		case C_PARSER_TRAILER: return PSTR_C("Trailer");
+		default: return PSTR_C("???");
+	}
+})
+
+void AsyncRequestChunkedContentParser::_parse(void *&buf, size_t &len) {
+	char *str = (char*)buf;
+	while (len) {
+		if (_state == C_PARSER_DATA) {
+			// Chunk data is handed over without copying
+			size_t dataLen = len < _chunkLeft? len : _chunkLeft;
+			_chunkLeft-= dataLen;
+			_bodyLen+= dataLen;
+			buf = str+= dataLen;
+			len-= dataLen;
+			if (!_chunkLeft) _state = C_PARSER_DATAEND;
+			if (!_feedContent(str-dataLen, dataLen)) return;
+			continue;
+		}
+
+		// Find new line in buf
+		char *eol = (char*)memchr(str, '\n', len);
+		size_t i = eol? eol - str : len;
+		if (_temp.length()+i > REQUEST_PARAM_KEYMAX) {
+			ESPWS_DEBUG("[%s] Chunk header exceeds length limit!\n", _request._remoteIdent.c_str());
+			_request.send_P(400, PSTR_C("Malformed chunked content"), FC("text/plain"));
+			return;
+		}
+		_temp.concat(str, i);
+		if (eol) i++;
+		buf = str+= i;
+		len-= i;
+		if (!eol) break;
+		_temp.trim();
+		if (!_handleLine()) {
+			// Finished (or failed), may no longer exist
+			return;
+		}
+		_temp.clear();
+	}
+}
+
+bool AsyncRequestChunkedContentParser::_handleLine(void) {
+	switch (_state) {
+		case C_PARSER_SIZE: {
+			size_t chunkSize = 0;
+			uint8_t digits = 0;
+			for (char c : _temp) {
+				// Chunk extensions are ignored
+				if (c == ';' || c == ' ') break;
+				if (!isxdigit(c) || ++digits > 7) {
+					digits = 0;
+					break;
+				}
+				chunkSize = (chunkSize << 4) | (c <= '9'? c - '0' : (c | 0x20) - 'a' + 10);
+			}
+			if (!digits) {
+				ESPWS_DEBUG("[%s] Invalid chunk size '%s'\n",
+					_request._remoteIdent.c_str(), _temp.c_str());
+				_request.send_P(400, PSTR_C("Malformed chunked content"), FC("text/plain"));
+				return false;
+			}
+			ESPWS_DEBUGVV("[%s] Chunk of %d bytes\n", _request._remoteIdent.c_str(), chunkSize);
+			_chunkLeft = chunkSize;
+			_state = chunkSize? C_PARSER_DATA : C_PARSER_TRAILER;
+		} break;
+
+		case C_PARSER_DATAEND:
+			if (_temp) {
+				ESPWS_DEBUG("[%s] Missing chunk terminator\n", _request._remoteIdent.c_str());
+				_request.send_P(400, PSTR_C("Malformed chunked content"), FC("text/plain"));
+				return false;
+			}
+			_state = C_PARSER_SIZE;
+			break;
+
+		case C_PARSER_TRAILER:
+			if (_temp) {
+				ESPWS_DEBUGV("[%s] - Trailer: '%s'\n", _request._remoteIdent.c_str(), _temp.c_str());
+				break;
+			}
+			ESPWS_DEBUGV("[%s] Chunked body complete (%d bytes)\n",
+				_request._remoteIdent.c_str(), _bodyLen);
+			// Now that the length is known, an empty buffer lets the body parser finish
+			__setContentLength(_bodyLen);
+			if (_feedContent(nullptr, 0)) {
+				ESPWS_DEBUG("[%s] Body parser did not complete\n", _request._remoteIdent.c_str());
+				_request.send_P(500, PSTR_C("Error handling request body"), FC("text/plain"));
+			} else if (__reqState() == REQUEST_RECEIVED) {
+				// We are done!
+				delete this;
+			}
+			return false;
+
+		default:
+			ESPWS_DEBUG("[%s] ERROR: Invalid chunked parser state '%s'\n",
+				_request._remoteIdent.c_str(), SFPSTR(_stateToString()));
+			__reqState(REQUEST_HALT);
+			return false;
+	}
+	return true;
+}
+
+bool AsyncRequestChunkedContentParser::_feedContent(void *buf, size_t len) {
+	_content->_parse(buf, len);
+	if (__reqState() == REQUEST_BODY) return true;
+	// Body parser removes itself from the request once complete
+	if (__reqState() == REQUEST_RECEIVED) _content = nullptr;
+	return false;
+}
+
 void AsyncRequestPassthroughContentParser::_parse(void *&buf, size_t &len) {
 	// Simply track the upload progress and invoke handler
 	if (!__reqHandler()->_handleBody(_request, _curOfs, buf, len)) {
@@ -425,13 +559,20 @@ typedef enum {
 class AsyncSimpleFormContentParser: public AsyncWebParser {
 	protected:
 		SimpleFormParserState _state;
+		bool _keep;
+		bool _streaming;
+		// Pending escape: 1 = '%' seen, 2 = first hex digit also seen
+		uint8_t _escLen;
+		char _escHi;
 		size_t _curOfs;
 		size_t _valOfs;
 		size_t _memCached;
-		String _temp;
+		// Decoded text goes here first; a key must fit, a value is passed on in slices
+		char _scratch[REQUEST_PARAM_KEYMAX];
+		size_t _scratchLen;
 		String _key;
+		String _value;
 
-		bool _needFlush(void) { return _temp.length() > REQUEST_PARAM_MEMCACHE; }
 		bool _memCacheFull(void) { return _memCached > REQUEST_PARAM_MEMCACHE; }
 
 		bool _checkReachEnd(std::function<void(void)> callback) {
@@ -457,123 +598,141 @@ class AsyncSimpleFormContentParser: public AsyncWebParser {
 			}
 		})
 
-		bool _pushKeyVal(String &&value, bool _flush) {
-			if (_state == SF_PARSER_VALUE) {
-				bool HandlerCallback = _flush || _memCacheFull();
-				if (HandlerCallback) {
-					ESPWS_DEBUGVV_S(L,"[%s] * [%s]@%0.4X = '%s'\n",
-						_request._remoteIdent.c_str(), _key.c_str(), _valOfs, value.c_str());
-					__reqHandler()->_handleParamData(_request, _key, _valOfs,
-						value.begin(), value.length());
-					_valOfs+= value.length();
-				} else {
-					ESPWS_DEBUGVV_S(L,"[%s] + [%s] = '%s'\n",
-						_request._remoteIdent.c_str(), _key.c_str(), value.c_str());
-					_memCached+= _key.length();
-					_memCached+= value.length();
-					__addParam(_key, value);
+		bool _putChars(char const *buf, size_t len) {
+			while (len) {
+				if (_scratchLen == sizeof(_scratch)) {
+					if (_state == SF_PARSER_KEY) {
+						ESPWS_DEBUG_S(L,"[%s] Simple form token exceeds length limit!\n",
+							_request._remoteIdent.c_str());
+						_request.send_P(500, PSTR_L("Excessive token length"), FL("text/plain"));
+						return false;
+					}
+					_emitValue(_scratch, _scratchLen, false);
+					_scratchLen = 0;
 				}
-				return true;
+				size_t copyLen = sizeof(_scratch) - _scratchLen;
+				if (copyLen > len) copyLen = len;
+				memcpy(_scratch + _scratchLen, buf, copyLen);
+				_scratchLen+= copyLen;
+				buf+= copyLen;
+				len-= copyLen;
 			}
+			return true;
+		}
 
-			ESPWS_DEBUG_S(L,"[%s] ERROR: Invalid simple form parser state '%s'\n",
-				_request._remoteIdent.c_str(), SFPSTR(_stateToString()));
-			__reqState(REQUEST_HALT);
-			return false;
+		bool _putEscape(void) {
+			// Malformed escapes are kept as-is
+			char esc[2] = {'%', _escHi};
+			size_t escLen = _escLen;
+			_escLen = 0;
+			return _putChars(esc, escLen);
+		}
+
+		void _emitValue(char *buf, size_t len, bool final) {
+			if (!_streaming) {
+				_value.concat(buf, len);
+				if (_value.length() <= REQUEST_PARAM_MEMCACHE && !_memCacheFull()) {
+					if (final) {
+						ESPWS_DEBUGVV_S(L,"[%s] + [%s] = '%s'\n",
+							_request._remoteIdent.c_str(), _key.c_str(), _value.c_str());
+						_memCached+= _key.length();
+						_memCached+= _value.length();
+						__addParam(_key, _value);
+					}
+					return;
+				}
+				// Too large to keep, pass on what has been collected
+				_streaming = true;
+				buf = _value.begin();
+				len = _value.length();
+			}
+			ESPWS_DEBUGVV_S(L,"[%s] * [%s]@%0.4X (%d bytes)%s\n", _request._remoteIdent.c_str(),
+				_key.c_str(), _valOfs, len, final? " final" : "");
+			__reqHandler()->_handleParamData(_request, _key, _valOfs, buf, len);
+			_valOfs+= len;
+			if (_value) _value.clear(true);
 		}
 
-		String _decodePartial(void) {
-			// ASSUMPTION: Buffer size always > 2
-			// Check if the last two char in buffer contains encoder preamble
-			String __temp;
-			if (_temp.end()[-2] == '%') {
-				__temp.concat(&_temp.end()[-2],2);
-				_temp.remove(_temp.length()-2);
-			} else if (_temp.end()[-1] == '%') {
-				__temp.concat('%');
-				_temp.remove(_temp.length()-1);
+		void _endKey(void) {
+			_key.clear();
+			_key.concat(_scratch, _scratchLen);
+			_scratchLen = 0;
+			_keep = __reqHandler()->_keepParam(_request, _key);
+			_streaming = !_keep;
+			_valOfs = 0;
+			_state = SF_PARSER_VALUE;
+		}
+
+		bool _endField(void) {
+			if (_escLen && !_putEscape()) return false;
+			if (_state == SF_PARSER_KEY) {
+				// Skip empty fields
+				if (!_scratchLen) return true;
+				_endKey();
 			}
-			String _ret = urlDecode(_temp.begin(), _temp.length());
-			_temp = std::move(__temp);
-			return _ret;
+			_emitValue(_scratch, _scratchLen, true);
+			_scratchLen = 0;
+			_state = SF_PARSER_KEY;
+			return true;
 		}
 
 	public:
 		AsyncSimpleFormContentParser(AsyncWebRequest &request)
-		: AsyncWebParser(request), _state(SF_PARSER_KEY),
-		_curOfs(0), _valOfs(0), _memCached(0) {
+		: AsyncWebParser(request), _state(SF_PARSER_KEY), _keep(true), _streaming(false),
+		_escLen(0), _curOfs(0), _valOfs(0), _memCached(0), _scratchLen(0) {
 			// Nothing
 		}
 
 		virtual void _parse(void *&buf, size_t &len) override {
 			char *str = (char*)buf;
-			while (len) {
-				char delim = '\0';
-				size_t limit = 0;
-				switch (_state) {
-					case SF_PARSER_KEY:
-						delim = '=';
-						limit = REQUEST_PARAM_KEYMAX;
-						break;
-					case SF_PARSER_VALUE:
-						delim = '&';
-						limit = -1;
-						break;
-				}
-
-				// Find param delimiter in buf
-				size_t i = 0;
-				while (str[i] != delim) {
-					if (i >= REQUEST_PARAM_MEMCACHE/2 || ++i >= len) {
-						// No delim, just add the buffer in _temp
-
-						// Guard maximum token length
-						if (_temp.length()+i > limit) {
-							ESPWS_DEBUG_S(L,"[%s] Simple form token exceeds length limit!\n",
-								_request._remoteIdent.c_str());
-							_request.send_P(500, PSTR_L("Excessive token length"), FL("text/plain"));
-							return;
-						}
-						_temp.concat(str, i);
-						len-= i;
-						buf = str+= i;
-						_curOfs+= i;
-
-						// Have we reached the end?
-						if (_checkReachEnd([&]{
-							_pushKeyVal(urlDecode(_temp.begin(),_temp.length()), _valOfs);
-						})) return;
-
-						// Flush buffer if it is too large
-						if (_needFlush())
-							_pushKeyVal(_decodePartial(), true);
-						i = 0;
+			char *end = str + len;
+			_curOfs+= len;
+			// Everything is decoded as it arrives
+			buf = end;
+			len = 0;
+
+			while (str < end) {
+				if (_escLen) {
+					// Escapes may straddle buffers
+					if (hexDigitValue(*str) < 0) {
+						// Re-examine the current character after the literal escape
+						if (!_putEscape()) return;
+						continue;
+					}
+					if (_escLen == 1) {
+						_escHi = *str++;
+						_escLen = 2;
+						continue;
 					}
+					char c = (hexDigitValue(_escHi) << 4) | hexDigitValue(*str++);
+					_escLen = 0;
+					if (!_putChars(&c, 1)) return;
+					continue;
 				}
 
-				// Found new param token - extract it and parse
-				_temp.concat(str, i++);
-				len-= i;
-				buf = str+= i;
-				_curOfs+= i;
-
-				if (_temp) {
-					String item = urlDecode(_temp.begin(),_temp.length());
-					switch (_state) {
-						case SF_PARSER_KEY:
-							_key = std::move(item);
-							_state = SF_PARSER_VALUE;
-							break;
-						case SF_PARSER_VALUE:
-							_pushKeyVal(std::move(item), _valOfs);
-							_state = SF_PARSER_KEY;
-							_valOfs = 0;
-							break;
-					}
+				// Plain characters are copied in runs
+				char *run = str;
+				while (str < end && *str != '%' && *str != '+' && *str != '&' && *str != '=') str++;
+				if (str > run && !_putChars(run, str - run)) return;
+				if (str == end) break;
+
+				switch (*str++) {
+					case '%':
+						_escLen = 1;
+						break;
+					case '+':
+						if (!_putChars(" ", 1)) return;
+						break;
+					case '=':
+						if (_state == SF_PARSER_KEY) _endKey();
+						else if (!_putChars("=", 1)) return;
+						break;
+					case '&':
+						if (!_endField()) return;
+						break;
 				}
-				if (_checkReachEnd(nullptr)) return;
-				_temp.clear();
 			}
+			_checkReachEnd([&]{ _endField(); });
 		}
 };
 
@@ -597,13 +756,17 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 	protected:
 		MultipartFormParserState _state;
 		bool _filepart;
-		size_t _boundaryLen;
 		size_t _curOfs;
 		size_t _valOfs;
-		size_t _parseOfs;
 		size_t _memCached;
+		// Held-back tail (shorter than delimiter), or partial header line
 		String _temp;
-		String _boundary;
+		// Field value accumulated until delimiter
+		String _value;
+		// Part delimiter ("\r\n--" + boundary), and its Horspool skip table
+		String _delim;
+		size_t _delimLen;
+		uint8_t _skip[256];
 		String _key;
 		String _filename;
 		String _contentType;
@@ -641,9 +804,24 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 			}
 		})
 
+		// Returns the offset of the first delimiter in buffer, or `len` if not found
+		size_t _findDelimiter(char const *str, size_t len) {
+			size_t last = _delimLen - 1;
+			char const *delim = _delim.c_str();
+			size_t pos = 0;
+			while (pos + last < len) {
+				uint8_t c = str[pos + last];
+				if (c == (uint8_t)delim[last] && memcmp(str + pos, delim, last) == 0)
+					return pos;
+				pos+= _skip[c];
+			}
+			return len;
+		}
+
 		bool _pushKeyVal(String &&value, bool _flush) {
 			if (_state == MP_PARSER_VALUE) {
-				bool HandlerCallback = _flush || _memCacheFull();
+				bool HandlerCallback = _flush || _memCacheFull()
+					|| !__reqHandler()->_keepParam(_request, _key);
 				if (HandlerCallback) {
 					ESPWS_DEBUGVV_S(L,"[%s] * [%s]@%0.4X = '%s'\n",
 						_request._remoteIdent.c_str(), _key.c_str(), _valOfs, value.c_str());
@@ -668,7 +846,7 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 	public:
 		AsyncRequestMultipartFormContentParser(AsyncWebRequest &request)
 		: AsyncWebParser(request), _state(MP_PARSER_STARTUP), _filepart(false),
-			_curOfs(0), _valOfs(0), _parseOfs(0), _memCached(0) {
+			_curOfs(0), _valOfs(0), _memCached(0), _delimLen(0) {
 			int indexBoundary = _request.contentType().indexOf(FL("boundary="), 20);
 			if (indexBoundary < 0) {
 				ESPWS_DEBUG_S(L,"[%s] Missing boundary specification\n",
@@ -677,10 +855,24 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 				return;
 			}
 			const char* valStart = &_request.contentType().begin()[indexBoundary+9];
-			_boundary = getQuotedToken(valStart);
+			String boundary = getQuotedToken(valStart);
+			// RFC 2046 limits boundary to 70 characters, which keeps skips in a byte
+			if (!boundary || boundary.length() > 70) {
+				ESPWS_DEBUG_S(L,"[%s] Invalid boundary specification\n",
+					_request._remoteIdent.c_str());
+				_request.send_P(400, PSTR_L("Invalid boundary specification"), FL("text/plain"));
+				return;
+			}
 			ESPWS_DEBUGVV_S(L,"[%s] Part boundary: '%s'\n",
-				_request._remoteIdent.c_str(), _boundary.c_str());
-			_boundaryLen = _boundary.length();
+				_request._remoteIdent.c_str(), boundary.c_str());
+			_delim = FL("\r\n--");
+			_delim.concat(boundary);
+			_delimLen = _delim.length();
+			memset(_skip, _delimLen, sizeof(_skip));
+			for (size_t i = 0; i < _delimLen - 1; i++)
+				_skip[(uint8_t)_delim[i]] = _delimLen - 1 - i;
+			// The first delimiter may come without the leading line break
+			_temp = FL("\r\n");
 			__setContentType(String(_request.contentType().begin(),19));
 		}
 
@@ -728,7 +920,7 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 			return true;
 		}
 
-		bool _handlePartBoundary(void *buf, size_t len) {
+		bool _handlePartBoundary(char *buf, size_t len) {
 			switch (_state) {
 				case MP_PARSER_STARTUP:
 					if (len) {
@@ -737,8 +929,13 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 					}
 					return true;
 
-				case MP_PARSER_VALUE:
-					return _pushKeyVal(len? String((char*)buf,len) : String(), false);
+				case MP_PARSER_VALUE: {
+					_value.concat(buf, len);
+					// Once partially flushed, the rest of the value goes to handler too
+					bool Ret = _pushKeyVal(std::move(_value), _valOfs);
+					_value = String();
+					return Ret;
+				}
 
 				case MP_PARSER_CONTENT:
 					if (__reqHandler()->_handleUploadData(_request, _key, _filename,
@@ -754,17 +951,22 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 			return false;
 		}
 
-		bool _handlePartMiddle(void *buf, size_t len) {
+		bool _handlePartMiddle(char *buf, size_t len) {
+			if (!len) return true;
 			switch (_state) {
 				case MP_PARSER_STARTUP:
-					if (len) {
-						ESPWS_DEBUG_S(L,"[%s] WARNING: Ignoring startup data (%d bytes)\n",
-							_request._remoteIdent.c_str(), len);
-					}
+					ESPWS_DEBUG_S(L,"[%s] WARNING: Ignoring startup data (%d bytes)\n",
+						_request._remoteIdent.c_str(), len);
 					return true;
 
-				case MP_PARSER_VALUE:
-					return _pushKeyVal(len? String((char*)buf,len) : String(), true);
+				case MP_PARSER_VALUE: {
+					// Values are held back to be delivered whole, unless too long
+					_value.concat(buf, len);
+					if (_value.length() <= REQUEST_PARAM_MEMCACHE) return true;
+					bool Ret = _pushKeyVal(std::move(_value), true);
+					_value = String();
+					return Ret;
+				}
 
 				case MP_PARSER_CONTENT: {
 					size_t __valOfs = _valOfs;
@@ -780,149 +982,155 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 			return false;
 		}
 
-		virtual void _parse(void *&buf, size_t &len) override {
-			char *str;
-			size_t strlen;
-			if (_temp) {
-				_temp.concat((char*)buf, len);
-				str = _temp.begin();
-				strlen = _temp.length();
-			} else {
-				str = (char*)buf;
-				strlen = len;
+		// Hands over part data, up to the delimiter if `final`
+		bool _emitPart(char *buf, size_t len, bool final) {
+			if (final? _handlePartBoundary(buf,len) : _handlePartMiddle(buf,len))
+				return true;
+			if (!_request._responded()) {
+				ESPWS_DEBUGVV_S(L,"[%s] Body part %s handling terminated abnormally\n",
+					_request._remoteIdent.c_str(), final? "boundary" : "section");
+				_request.send_P(500, PSTR_L("Error handling request body part"), FL("text/plain"));
 			}
+			return false;
+		}
+
+		void _nextPart(void) {
+			_state = MP_PARSER_BOUNDARY;
+			_key.clear();
+			_filepart = false;
+			_filename.clear();
+			_contentType.clear();
+			_valOfs = 0;
+		}
+
+		virtual void _parse(void *&buf, size_t &len) override {
+			char *str = (char*)buf;
+			size_t strlen = len;
 			_curOfs += len;
 			len = 0; // Assume we will take everything
 
-			while (strlen && buf) {
+			while (strlen) {
 				switch (_state) {
 					case MP_PARSER_STARTUP:
 					case MP_PARSER_VALUE:
 					case MP_PARSER_CONTENT: {
-						size_t i = _parseOfs;
-						bool partBoundary = false;
-						while (i < REQUEST_PARAM_MEMCACHE && i < strlen) {
-							if (_state == MP_PARSER_STARTUP) {
-								if (str[i++] == '-') {
-									if (i+1+_boundaryLen <= strlen) {
-										if (str[i] == '-' &&
-											_boundary.startsWith(&str[i+1], _boundaryLen, 0, false)) {
-											partBoundary = true;
-											break;
-										}
-									} else break;
-								}
+						size_t i;
+						if (_temp) {
+							// A delimiter may straddle the held-back tail and the new data,
+							//   only copy as much as needed to find out
+							size_t carryLen = _temp.length();
+							size_t peekLen = strlen < _delimLen - 1? strlen : _delimLen - 1;
+							_temp.concat(str, peekLen);
+							i = _findDelimiter(_temp.begin(), _temp.length());
+							if (i < _temp.length()) {
+								ESPWS_DEBUGVV_S(L,"[%s] Boundary detected @%d (straddled)\n",
+									_request._remoteIdent.c_str(), i);
+								if (!_emitPart(_temp.begin(), i, true)) return;
+								i+= _delimLen - carryLen;
+								str+= i;
+								strlen-= i;
+								_temp.clear();
+								_nextPart();
+								break;
 							}
-							if (str[i++] == '\r') {
-								if (i+3+_boundaryLen <= strlen) {
-									if (str[i] == '\n' && str[i+1] == '-' && str[i+2] == '-' &&
-											_boundary.startsWith(&str[i+3], _boundaryLen, 0, false)) {
-										partBoundary = true;
-										break;
-									}
-								} else break;
+							if (peekLen < _delimLen - 1) {
+								// New data is too short to rule out a delimiter
+								str+= peekLen;
+								strlen-= peekLen;
+								if (_temp.length() > _delimLen - 1) {
+									size_t safeLen = _temp.length() - (_delimLen - 1);
+									if (!_emitPart(_temp.begin(), safeLen, false)) return;
+									_temp.remove(0, safeLen);
+								}
+								break;
 							}
+							// No delimiter starts in the held-back tail
+							if (!_emitPart(_temp.begin(), carryLen, false)) return;
+							_temp.clear();
 						}
-						if (partBoundary) {
+
+						// Slices are handed over straight from the incoming buffer
+						i = _findDelimiter(str, strlen);
+						if (i < strlen) {
 							ESPWS_DEBUGVV_S(L,"[%s] Boundary detected @%d\n",
 								_request._remoteIdent.c_str(), i);
-							if (!_handlePartBoundary(str,i-1)) {
-								if (!_request._responded()) {
-									ESPWS_DEBUGVV_S(L,"[%s] Body part boundary handling terminated abnormally\n",
-										_request._remoteIdent.c_str());
-									_request.send_P(500, PSTR_L("Error handling request body part boundary"), FL("text/plain"));
-								}
-								return;
-							}
-							i+= (str[i] == '-')? 1 : 3;
-							i+= _boundaryLen;
+							if (!_emitPart(str, i, true)) return;
+							i+= _delimLen;
 							str+= i;
 							strlen-= i;
-							_state = MP_PARSER_BOUNDARY;
-							_key.clear();
-							_filepart = false;
-							_filename.clear();
-							_contentType.clear();
-							_parseOfs = 0;
+							_nextPart();
 						} else {
-							if (i >= REQUEST_PARAM_MEMCACHE) {
-								if (!_handlePartMiddle(str,i)) {
-									if (!_request._responded()) {
-										ESPWS_DEBUGVV_S(L,"[%s] Body part section handling terminated abnormally\n",
-											_request._remoteIdent.c_str());
-										_request.send_P(500, PSTR_L("Error handling request body part section"), FL("text/plain"));
-									}
-									return;
-								}
-								str+= i;
-								strlen-= i;
-								_parseOfs = 0;
-							} else {
-								_parseOfs = i;
-								buf = nullptr;
-							}
+							// Only a tail shorter than the delimiter may be part of one
+							size_t safeLen = strlen > _delimLen - 1? strlen - (_delimLen - 1) : 0;
+							if (!_emitPart(str, safeLen, false)) return;
+							_temp.concat(str + safeLen, strlen - safeLen);
+							strlen = 0;
 						}
 					} break;
 
 					case MP_PARSER_BOUNDARY:
 					case MP_PARSER_HEADER: {
 						// Find new line in buf
-						size_t i = _parseOfs;
-						while (str[i] != '\n') {
-							if (++i >= strlen) {
-								// No new line, wait for next buffer
-								_parseOfs = i;
-								buf = nullptr;
-								break;
-							}
+						char *eol = (char*)memchr(str, '\n', strlen);
+						size_t i = eol? eol - str : strlen;
+						if (_temp.length() + i > REQUEST_PARAM_MEMCACHE) {
+							ESPWS_DEBUG_S(L,"[%s] Body part header exceeds length limit!\n",
+								_request._remoteIdent.c_str());
+							_request.send_P(500, PSTR_L("Excessive part header length"), FL("text/plain"));
+							return;
 						}
-						if (buf) {
-							// Found new line - extract it and parse
-							if (i > 1) {
-								String line = String(str, i-1);
-								line.trim();
-								if (_state == MP_PARSER_HEADER) {
-									if (!_handleHeader(line)) {
-										if (!_request._responded()) {
-											ESPWS_DEBUGVV_S(L,"[%s] Body part header handling terminated abnormally\n",
-												_request._remoteIdent.c_str());
-											_request.send_P(500, PSTR_L("Error handling request body part header"), FL("text/plain"));
-										}
-										return;
-									}
-								} else {
-									if (line != FL("--")) {
-										ESPWS_DEBUG_S(L,"[%s] Unrecognised part boundary preamble '%s'\n",
-											_request._remoteIdent.c_str(), line.c_str());
-										_request.send_P(500, PSTR_L("Unrecognised part boundary preamble"), FL("text/plain"));
-										return;
-									} else {
-										ESPWS_DEBUGVV_S(L,"[%s] Part Start\n", _request._remoteIdent.c_str());
-										_state = MP_PARSER_TERMINATE;
+						_temp.concat(str, i);
+						if (!eol) {
+							// No new line, wait for next buffer
+							strlen = 0;
+							break;
+						}
+						str+= i+1;
+						strlen-= i+1;
+
+						// Found new line - extract it and parse
+						String line = std::move(_temp);
+						_temp = String();
+						line.trim();
+						if (line) {
+							if (_state == MP_PARSER_HEADER) {
+								if (!_handleHeader(line)) {
+									if (!_request._responded()) {
+										ESPWS_DEBUGVV_S(L,"[%s] Body part header handling terminated abnormally\n",
+											_request._remoteIdent.c_str());
+										_request.send_P(500, PSTR_L("Error handling request body part header"), FL("text/plain"));
 									}
+									return;
 								}
 							} else {
-								if (_state == MP_PARSER_HEADER) {
-									if (_filepart) {
-										_state = MP_PARSER_CONTENT;
-										if (!_filename) {
-											ESPWS_DEBUG_S(L,"[%s] WARNING: Empty file name\n",
-												_request._remoteIdent.c_str());
-										}
-										if (!_contentType) {
-											ESPWS_DEBUG_S(L,"[%s] WARNING: No content type specified\n",
-												_request._remoteIdent.c_str());
-											_contentType = FL("text/plain");
-										}
-									} else _state = MP_PARSER_VALUE;
+								if (line != FL("--")) {
+									ESPWS_DEBUG_S(L,"[%s] Unrecognised part boundary preamble '%s'\n",
+										_request._remoteIdent.c_str(), line.c_str());
+									_request.send_P(500, PSTR_L("Unrecognised part boundary preamble"), FL("text/plain"));
+									return;
 								} else {
-									ESPWS_DEBUGVV_S(L,"[%s] Part End\n", _request._remoteIdent.c_str());
-									_state = MP_PARSER_HEADER;
+									ESPWS_DEBUGVV_S(L,"[%s] Part Start\n", _request._remoteIdent.c_str());
+									_state = MP_PARSER_TERMINATE;
 								}
 							}
-							str+= i+1;
-							strlen-= i+1;
-							_parseOfs = 0;
+						} else {
+							if (_state == MP_PARSER_HEADER) {
+								if (_filepart) {
+									_state = MP_PARSER_CONTENT;
+									if (!_filename) {
+										ESPWS_DEBUG_S(L,"[%s] WARNING: Empty file name\n",
+											_request._remoteIdent.c_str());
+									}
+									if (!_contentType) {
+										ESPWS_DEBUG_S(L,"[%s] WARNING: No content type specified\n",
+											_request._remoteIdent.c_str());
+										_contentType = FL("text/plain");
+									}
+								} else _state = MP_PARSER_VALUE;
+							} else {
+								ESPWS_DEBUGVV_S(L,"[%s] Part End\n", _request._remoteIdent.c_str());
+								_state = MP_PARSER_HEADER;
+							}
 						}
 					} break;
 
@@ -936,17 +1144,16 @@ class AsyncRequestMultipartFormContentParser: public AsyncWebParser {
 						ESPWS_DEBUG_S(L,"[%s] ERROR: Invalid multi-part form parser state '%s'\n",
 							_request._remoteIdent.c_str(), SFPSTR(_stateToString()));
 						__reqState(REQUEST_HALT);
+						return;
 				}
 			}
-			if (strlen) _temp = String(str, strlen);
-			else _temp.clear();
 			_checkReachEnd([&]{
 				if (_state != MP_PARSER_TERMINATE) {
 					ESPWS_DEBUG_S(L,"[%s] ERROR: Form un-terminated at end of body!\n",
 						_request._remoteIdent.c_str());
 					ESPWS_DEBUGVDO({
-						size_t tailLen = (_temp.length() <= (_boundaryLen+8))?
-							_temp.length() : (_boundaryLen+8);
+						size_t tailLen = (_temp.length() <= (_delimLen+4))?
+							_temp.length() : (_delimLen+4);
 						String tailStr = _temp.substring(_temp.length()-tailLen);
 						tailStr.replace('\0','.');
 						ESPWS_LOG_S(L,"[%s] Buffer tail (%d): '%s'\n",
@@ -81,6 +81,9 @@ class AsyncWebParser {
 		{ _request._contentType = std::move(newContentType); }
 		void __setContentLength(size_t newContentLength)
 		{ _request._contentLength = newContentLength; }
+#ifdef HANDLE_REQUEST_CONTENT
+		void __setChunked(bool state) { _request._chunked = state; }
+#endif
 
 #ifdef HANDLE_AUTHENTICATION
 		WebACLMatchResult __setSession(WebAuthSession* session)
@@ -88,11 +91,16 @@ class AsyncWebParser {
 #endif
 
 		void __addHeader(String const &key, String const &value) {
-			AsyncWebHeader* Header = _request._headers.get_if([&](AsyncWebHeader const &h){
-				return key.equalsIgnoreCase(h.name);
-			});
+			AsyncWebHeader* Header = _request._headerIndex.built()?
+				_request._headerIndex.find(key.c_str()) :
+				_request._headers.get_if([&](AsyncWebHeader const &h){
+					return key.equalsIgnoreCase(h.name);
+				});
 			if (Header) Header->values.append(std::move(value));
-			else _request._headers.append(AsyncWebHeader(std::move(key), std::move(value)));
+			else {
+				_request._headers.append(AsyncWebHeader(std::move(key), std::move(value)));
+				_request._headerIndex.append(_request._headers, _request._headers.back());
+			}
 		}
 #ifdef HANDLE_REQUEST_CONTENT
 
@@ -100,14 +108,16 @@ class AsyncWebParser {
 		AsyncWebParam& __addParam(String &key, String &value) {
 			if (key.endsWith("[]",2,0,false)) {
 				_request._params.append(AsyncWebParam(std::move(key), std::move(value)));
+				_request._paramIndex.append(_request._params, _request._params.back());
 				return _request._params.back();
-			} else return _request._addUniqueNameVal(_request._params, key, value);
+			} else return _request._addUniqueNameVal(_request._params, _request._paramIndex, key, value);
 		}
 
 		AsyncWebUpload& __addUpload(String &key, String &filename, String &contentType,
 			size_t contentLength) {
 			_request._uploads.append(AsyncWebUpload(std::move(key), std::move(filename)));
 			auto& Item = _request._uploads.back();
+			_request._uploadIndex.append(_request._uploads, Item);
 			Item.contentType = std::move(contentType);
 			Item.contentLength = contentLength;
 			return Item;
@@ -193,6 +203,42 @@ class AsyncRequestPassthroughContentParser: public AsyncWebParser {
 typedef std::function<AsyncWebParser*(AsyncWebRequest &request)> ArBodyParserMaker;
 extern LinkedList<ArBodyParserMaker> BodyParserRegistry;
 
+// First matching registered body parser, or the pass-through parser
+AsyncWebParser* makeBodyParser(AsyncWebRequest &request);
+
+/*
+ * CHUNKED CONTENT PARSER :: Decodes chunked transfer coding in place, and feeds the
+ * decoded content to the body parser; content length is set when the last chunk arrives
+ * */
+typedef enum {
+	C_PARSER_SIZE,
+	C_PARSER_DATA,
+	C_PARSER_DATAEND,
+	C_PARSER_TRAILER
+} ChunkedParserState;
+
+class AsyncRequestChunkedContentParser: public AsyncWebParser {
+	protected:
+		ChunkedParserState _state;
+		AsyncWebParser *_content;
+		size_t _chunkLeft;
+		size_t _bodyLen;
+		String _temp;
+
+		bool _feedContent(void *buf, size_t len);
+		bool _handleLine(void);
+
+	public:
+		AsyncRequestChunkedContentParser(AsyncWebRequest &request)
+		: AsyncWebParser(request), _state(C_PARSER_SIZE),
+			_content(makeBodyParser(request)), _chunkLeft(0), _bodyLen(0) {}
+		~AsyncRequestChunkedContentParser(void) { delete _content; }
+
+		virtual void _parse(void *&buf, size_t &len) override;
+
+		ESPWS_DEBUGDO(PGM_P _stateToString(void) const override);
+};
+
 #endif
 
 #endif /* AsyncWebRequestParser_H_ */
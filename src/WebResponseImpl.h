@@ -26,6 +26,10 @@
 
 #include <ESPAsyncWebServer.h>
 
+#ifdef RESPONSE_COMPRESSION
+#include "WebCompressor.h"
+#endif
+
 String const& GetPlatformSignature(void);
 
 class AsyncSimpleResponse: public AsyncWebResponse {
@@ -153,7 +157,10 @@ class AsyncFileResponse: public AsyncBufferedResponse {
 		AsyncFileResponse(File const& content, String const &path,
 			String const &contentType=String(), int code=200, bool download=false);
 
-		static String contentTypeByName(String const &filename);
+		// Returns nullptr if the extension is unknown
+		static PGM_P contentTypeByName(char const *filename);
+		// Registers (or overrides) an extension, with or without the leading dot
+		static bool addContentType(char const *extension, char const *type);
 };
 
 class AsyncStreamResponse: public AsyncBufferedResponse {
@@ -179,6 +186,19 @@ class AsyncProgmemResponse: public AsyncBufferedResponse {
 		AsyncProgmemResponse(int code, PGM_P content, String const &contentType, size_t len);
 };
 
+class AsyncPackResponse: public AsyncProgmemResponse {
+	private:
+		PGM_P _head;
+
+	protected:
+		virtual void _assembleHead(void) override;
+
+	public:
+		// Content type and other headers come pre-formatted in the PROGMEM header block
+		AsyncPackResponse(int code, PGM_P content, size_t len, PGM_P head)
+			: AsyncProgmemResponse(code, content, String(), len), _head(head) {}
+};
+
 class AsyncCallbackResponse: public AsyncBufferedResponse {
 	private:
 		AwsResponseFiller _callback;
@@ -195,14 +215,192 @@ class AsyncChunkedResponse: public AsyncBufferedResponse {
 	private:
 		AwsResponseFiller _callback;
 		size_t _chunkCnt;
+		size_t _chunkOfs;
+		size_t _stashSize;
+#ifdef RESPONSE_COMPRESSION
+		bool _compress;
+		bool _plainDone;
+		GzipDeflater *_deflater;
+
+		void _setupCompression(void);
+		size_t _fillCompressed(uint8_t *buf, size_t maxLen);
+#endif
 
 	protected:
+		// HTTP/1.0 clients get an unsized body (ended by closing) instead of 505
+		bool _plainFallback;
+
 		virtual void _assembleHead(void) override;
 		virtual void _prepareContentSendBuf(size_t space) override;
+		// Fills chunk payload only, consecutive filler outputs are coalesced
 		virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
 
 	public:
 		AsyncChunkedResponse(int code, AwsResponseFiller callback, String const &contentType);
+#ifdef RESPONSE_COMPRESSION
+		~AsyncChunkedResponse() { delete _deflater; }
+
+		// Textual content is gzipped when the client accepts it (enabled by default)
+		void setCompression(bool enable);
+#endif
+};
+
+// Fixed capacity FIFO, content is drained without shifting
+// Writes that do not fit are refused whole, and flag a write error
+class RingBufferPrint: public Print {
+	private:
+		uint8_t *_buf;
+		size_t _size;
+		size_t _head = 0;
+		size_t _len = 0;
+
+	public:
+		RingBufferPrint(size_t size);
+		RingBufferPrint(RingBufferPrint const&) = delete;
+		~RingBufferPrint() { free(_buf); }
+
+		size_t capacity(void) const { return _size; }
+		size_t available(void) const { return _len; }
+		size_t space(void) const { return _size - _len; }
+		size_t read(uint8_t *buf, size_t len);
+
+		virtual size_t write(uint8_t const *data, size_t len) override;
+		virtual size_t write(uint8_t data) override { return write(&data, 1); }
+		using Print::write;
 };
 
+// Chunked content printed piece by piece into a fixed ring buffer
+class AsyncRingChunkedResponse: public AsyncChunkedResponse {
+	private:
+		size_t _fillRing(uint8_t *buf, size_t len);
+
+	protected:
+		size_t const _pieceMax;
+		RingBufferPrint _ring;
+		bool _done;
+
+		// Sends 500 if the ring buffer could not be allocated
+		virtual void _assembleHead(void) override;
+		// Prints at most _pieceMax bytes, sets _done after the last piece;
+		//   printing more aborts the response
+		virtual void _printPiece(void) = 0;
+
+	public:
+		AsyncRingChunkedResponse(int code, String const &contentType,
+			size_t bufSize, size_t pieceMax);
+};
+
+typedef enum {
+	DIRLIST_HTML,      // Sub-directories are scanned for content counts
+	DIRLIST_HTML_LAZY, // Sub-directories are listed without scanning
+	DIRLIST_JSON,
+} DirListFormat;
+
+class AsyncDirListResponse: public AsyncRingChunkedResponse {
+	private:
+		typedef enum {
+			DIRLIST_PREAMBLE,
+			DIRLIST_TITLE,   // URL, printed over as many pieces as needed
+			DIRLIST_HEAD,
+			DIRLIST_HEADING, // URL again
+			DIRLIST_HEADER,
+			DIRLIST_ENTRIES,
+		} DirListStage;
+
+		Dir _dir;
+		DirListFormat const _format;
+		bool const _hasParent;
+		DirListStage _stage;
+		size_t _entryCnt;
+		size_t const _cursor;
+		size_t _skip;
+		size_t const _limit;
+		uint32_t _startTS;
+		size_t _urlOfs;
+
+		bool _printURLSlice(size_t budget);
+		void _printEntryHTML(void);
+		void _printEntryJSON(void);
+		void _printJSONString(char const *str);
+		size_t _printJSONChar(char c);
+
+	protected:
+		virtual void _printPiece(void) override;
+		virtual size_t _process(size_t resShare) override;
+
+	public:
+		// Skips the first `cursor` entries, and stops after `limit` entries (if non-zero)
+		AsyncDirListResponse(Dir const &dir, DirListFormat format, bool hasParent,
+			size_t cursor = 0, size_t limit = 0);
+};
+
+// Runs a task in steps on scheduler ticks, then replies (without content) with its outcome
+class AsyncDeferredResponse: public AsyncSimpleResponse {
+	private:
+		bool _pending;
+
+	protected:
+		// Makes some progress, returns the final status code, or 0 to be called again
+		virtual int _step(void) = 0;
+
+	public:
+		AsyncDeferredResponse(void): AsyncSimpleResponse(500), _pending(true) {}
+
+		virtual void _respond(AsyncWebRequest &request) override;
+		virtual size_t _process(size_t resShare) override;
+};
+
+#ifdef HANDLE_WEBDAV
+// WebDAV multi-status for the requested resource, and its children (if `dir` is valid)
+class AsyncPropFindResponse: public AsyncRingChunkedResponse {
+	private:
+		typedef enum {
+			PROPFIND_SELF,
+			PROPFIND_CHILDREN,
+		} PropFindStage;
+
+		Dir _dir;
+		bool const _isDir;
+		size_t const _size;
+		time_t const _mtime;
+		PropFindStage _stage;
+
+		void _printResponse(char const *name, bool isDir, size_t size, time_t mtime);
+		void _printHrefPart(char const *str);
+
+	protected:
+		virtual void _printPiece(void) override;
+
+	public:
+		AsyncPropFindResponse(Dir const &dir, bool isDir, size_t size, time_t mtime);
+};
+
+// Copies a file via a temporary file, which replaces the destination when complete
+//   (for a move, the source is removed afterwards)
+class AsyncFileCopyResponse: public AsyncDeferredResponse {
+	private:
+		Dir _dir;
+		String const _srcPath;
+		String const _dstPath;
+		String _tmpPath;
+		bool const _move;
+		bool const _replace;
+		std::function<void(void)> _onDone;
+		File _src;
+		File _tmp;
+		uint8_t *_buf;
+
+		int _finish(void);
+
+	protected:
+		virtual int _step(void) override;
+
+	public:
+		// `replace` indicates the destination exists (and will be overwritten)
+		AsyncFileCopyResponse(Dir const &dir, String const &srcPath, String const &dstPath,
+			bool move, bool replace, std::function<void(void)> const &onDone);
+		~AsyncFileCopyResponse();
+};
+#endif
+
 #endif /* AsyncWebResponseImpl_H_ */
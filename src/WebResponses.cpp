@@ -21,6 +21,8 @@
 
 #include "WebResponseImpl.h"
 
+#include <Units.h>
+
 extern "C" {
 	#include "lwip/opt.h"
 	#include "user_interface.h"
@@ -96,12 +98,14 @@ PGM_P AsyncWebResponse::_responseCodeToString(void) {
 		case 415: return PSTR_C("Unsupported Media Type");
 		case 416: return PSTR_C("Requested range not satisfiable");
 		case 417: return PSTR_C("Expectation Failed");
+		case 423: return PSTR_C("Locked");
 		case 500: return PSTR_C("Internal Server Error");
 		case 501: return PSTR_C("Not Implemented");
 		case 502: return PSTR_C("Bad Gateway");
 		case 503: return PSTR_C("Service Unavailable");
 		case 504: return PSTR_C("Gateway Time-out");
 		case 505: return PSTR_C("HTTP Version not supported");
+		case 507: return PSTR_C("Insufficient Storage");
 		default:  return PSTR_C("? Unknown Status Code ?");
 	}
 }
@@ -486,7 +490,10 @@ AsyncFileResponse::AsyncFileResponse(File const& content, String const &path,
 {
 	if (_content) {
 		_contentLength = _content.size();
-		_contentType = contentType? contentType : contentTypeByName(path);
+		if (!_contentType) {
+			PGM_P Type = contentTypeByName(path.c_str());
+			if (Type) _contentType = FPSTR(Type);
+		}
 
 		if (download) {
 			size_t filenameStart = path.lastIndexOf('/') + 1;
@@ -527,50 +534,118 @@ size_t AsyncFileResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
 	return outLen;
 }
 
-String AsyncFileResponse::contentTypeByName(String const &filename) {
-	int extensionStart = filename.lastIndexOf('.')+1;
-	String extension = filename.begin() + extensionStart;
-
-	if (extension == FC("htm") || extension == FC("html"))
-		return FC("text/html");
-	else if (extension == FC("css"))
-		return FC("text/css");
-	else if (extension == FC("json"))
-		return FC("application/json");
-	else if (extension == FC("js"))
-		return FC("text/javascript");
-	else if (extension == FC("png"))
-		return FC("image/png");
-	else if (extension == FC("gif"))
-		return FC("image/gif");
-	else if (extension == FC("jpg") || extension == FC("jpeg"))
-		return FC("image/jpeg");
-	else if (extension == FC("ico"))
-		return FC("image/x-icon");
-	else if (extension == FC("svg"))
-		return FC("image/svg+xml");
-	else if (extension == FC("eot"))
-		return FC("font/eot");
-	else if (extension == FC("woff"))
-		return FC("font/woff");
-	else if (extension == FC("woff2"))
-		return FC("font/woff2");
-	else if (extension == FC("ttf"))
-		return FC("font/ttf");
-	else if (extension == FC("xml"))
-		return FC("text/xml");
-	else if (extension == FC("txt"))
-		return FC("text/plain");
-	else if (extension == FC("xhtml"))
-		return FC("application/xhtml+xml");
-	else if (extension == FC("pdf"))
-		return FC("application/pdf");
-	else if (extension == FC("zip"))
-		return FC("application/zip");
-	else if (extension == FC("gz"))
-		return FC("application/x-gzip");
-
-	return String::EMPTY;
+#define CONTENTTYPE_EXTMAX 8
+
+struct ContentTypeRec {
+	char ext[CONTENTTYPE_EXTMAX];
+	char type[24];
+};
+
+// Sorted by extension, for binary search
+static ContentTypeRec const ContentTypes[] PROGMEM = {
+	{"avif", "image/avif"},
+	{"css", "text/css"},
+	{"eot", "font/eot"},
+	{"gif", "image/gif"},
+	{"gz", "application/x-gzip"},
+	{"htm", "text/html"},
+	{"html", "text/html"},
+	{"ico", "image/x-icon"},
+	{"jpeg", "image/jpeg"},
+	{"jpg", "image/jpeg"},
+	{"js", "text/javascript"},
+	{"json", "application/json"},
+	{"map", "application/json"},
+	{"mjs", "text/javascript"},
+	{"pdf", "application/pdf"},
+	{"png", "image/png"},
+	{"svg", "image/svg+xml"},
+	{"ttf", "font/ttf"},
+	{"txt", "text/plain"},
+	{"wasm", "application/wasm"},
+	{"webp", "image/webp"},
+	{"woff", "font/woff"},
+	{"woff2", "font/woff2"},
+	{"xhtml", "application/xhtml+xml"},
+	{"xml", "text/xml"},
+	{"zip", "application/zip"},
+};
+
+struct UserContentTypeRec {
+	char ext[CONTENTTYPE_EXTMAX];
+	char const *type;
+};
+
+static UserContentTypeRec *UserContentTypes = nullptr;
+static size_t UserContentTypeCnt = 0;
+
+// Lower-cased extension of filename, empty if absent or too long
+static bool _extensionOf(char const *filename, char (&ext)[CONTENTTYPE_EXTMAX]) {
+	char const *dot = strrchr(filename, '.');
+	if (!dot || strchr(dot, '/')) return false;
+	size_t len = 0;
+	while (*++dot) {
+		if (len >= CONTENTTYPE_EXTMAX-1) return false;
+		ext[len++] = tolower(*dot);
+	}
+	ext[len] = '\0';
+	return len;
+}
+
+PGM_P AsyncFileResponse::contentTypeByName(char const *filename) {
+	char ext[CONTENTTYPE_EXTMAX];
+	if (!_extensionOf(filename, ext)) return nullptr;
+
+	// User registrations take precedence (Note: returns RAM pointer, still *_P safe)
+	size_t lo = 0, hi = UserContentTypeCnt;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		int cmp = strcmp(ext, UserContentTypes[mid].ext);
+		if (!cmp) return UserContentTypes[mid].type;
+		if (cmp < 0) hi = mid; else lo = mid + 1;
+	}
+
+	lo = 0; hi = sizeof(ContentTypes) / sizeof(ContentTypeRec);
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		int cmp = strcmp_P(ext, ContentTypes[mid].ext);
+		if (!cmp) return ContentTypes[mid].type;
+		if (cmp < 0) hi = mid; else lo = mid + 1;
+	}
+	return nullptr;
+}
+
+bool AsyncFileResponse::addContentType(char const *extension, char const *type) {
+	char ext[CONTENTTYPE_EXTMAX];
+	if (!_extensionOf(extension, ext)) {
+		// Also accept bare extension
+		String dotExt('.');
+		dotExt.concat(extension);
+		if (!_extensionOf(dotExt.c_str(), ext)) return false;
+	}
+	char *typeDup = strdup(type);
+	if (!typeDup) return false;
+
+	size_t pos = 0;
+	while (pos < UserContentTypeCnt && strcmp(UserContentTypes[pos].ext, ext) < 0) pos++;
+	if (pos < UserContentTypeCnt && !strcmp(UserContentTypes[pos].ext, ext)) {
+		free((void*)UserContentTypes[pos].type);
+		UserContentTypes[pos].type = typeDup;
+		return true;
+	}
+	UserContentTypeRec *newTypes = (UserContentTypeRec*)realloc(UserContentTypes,
+		sizeof(UserContentTypeRec) * (UserContentTypeCnt + 1));
+	if (!newTypes) {
+		free(typeDup);
+		return false;
+	}
+	UserContentTypes = newTypes;
+	memmove(&UserContentTypes[pos+1], &UserContentTypes[pos],
+		sizeof(UserContentTypeRec) * (UserContentTypeCnt - pos));
+	strcpy(UserContentTypes[pos].ext, ext);
+	UserContentTypes[pos].type = typeDup;
+	UserContentTypeCnt++;
+	return true;
 }
 
 /*
@@ -618,6 +693,17 @@ size_t AsyncProgmemResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
 	return maxLen;
 }
 
+/*
+ * Asset Pack Content Response
+ * */
+
+void AsyncPackResponse::_assembleHead(void) {
+	addHeader(FC("Content-Length"), String(_contentLength));
+	_headers.concat(FPSTR(_head));
+	// Bypass content type guessing, it is already in the header block
+	AsyncSimpleResponse::_assembleHead();
+}
+
 /*
  * Callback Content Response
  * */
@@ -649,48 +735,725 @@ AsyncChunkedResponse::AsyncChunkedResponse(int code, AwsResponseFiller callback,
 	String const &contentType)
 	: AsyncBufferedResponse(code, contentType)
 	, _callback(callback)
+	, _chunkCnt(0)
+	, _chunkOfs(0)
+	, _stashSize(0)
+	, _plainFallback(false)
+#ifdef RESPONSE_COMPRESSION
+	, _compress(true)
+	, _plainDone(false)
+	, _deflater(nullptr)
+#endif
 {}
 
 void AsyncChunkedResponse::_assembleHead(void){
 	if (_request->version()) {
 		addHeader(FC("Transfer-Encoding"), FC("chunked"));
 		_chunkCnt = 0;
-	} else {
+#ifdef RESPONSE_COMPRESSION
+		if (_compress) _setupCompression();
+#endif
+	} else if (!_plainFallback) {
 		_code = 505;
 		_contentLength = 0; // Prevents fillBuffer from being called
 		_contentType.clear(true);
 		_headers.clear(true);
+	} else {
+		// Only closing the connection marks the end of an unsized body
+		_request->noKeepAlive();
 	}
 
 	AsyncBasicResponse::_assembleHead();
 }
 
+#ifdef RESPONSE_COMPRESSION
+
+static_assert(RESPONSE_DEFLATE_WINDOW >= DEFLATE_MIN_WINDOW && RESPONSE_DEFLATE_WINDOW <= DEFLATE_MAX_WINDOW,
+	"RESPONSE_DEFLATE_WINDOW out of range");
+
+void AsyncChunkedResponse::setCompression(bool enable) {
+	if (_started()) {
+		ESPWS_LOG("[%s] ERROR: Response already started, cannot change compression!\n");
+		return;
+	}
+	_compress = enable;
+}
+
+void AsyncChunkedResponse::_setupCompression(void) {
+	char const *type = _contentType.c_str();
+	if (strncmp_P(type, PSTR_C("text/"), 5) != 0 && !strstr_P(type, PSTR_C("json"))
+		&& !strstr_P(type, PSTR_C("xml")) && !strstr_P(type, PSTR_C("javascript")))
+		return;
+	addHeader(FC("Vary"), FC("Accept-Encoding"));
+
+	uint16_t qvals[ENCODING_COUNT];
+	parseAcceptEncoding(_request->acceptEncoding().c_str(), qvals);
+	if (!qvals[ENCODING_GZIP] || qvals[ENCODING_GZIP] < qvals[ENCODING_IDENTITY]) return;
+
+	// Rather send more bytes than starve everyone else of heap
+	size_t needHeap = GzipDeflater::memoryNeeded(RESPONSE_DEFLATE_WINDOW) + RESPONSE_DEFLATE_MINHEAP;
+	if (ESP.getFreeHeap() < needHeap) {
+		ESPWS_DEBUGV("[%s] Low heap, sending uncompressed\n", _request->_remoteIdent.c_str());
+		return;
+	}
+	if (_request->method() != HTTP_HEAD) {
+		_deflater = new GzipDeflater(RESPONSE_DEFLATE_WINDOW);
+		if (!_deflater->valid()) {
+			ESPWS_DEBUGV("[%s] Compressor allocation failed, sending uncompressed\n",
+				_request->_remoteIdent.c_str());
+			delete _deflater;
+			_deflater = nullptr;
+			return;
+		}
+	}
+	addHeader(FC("Content-Encoding"), FC("gzip"));
+}
+
+size_t AsyncChunkedResponse::_fillCompressed(uint8_t *buf, size_t maxLen) {
+	size_t outLen = 0;
+	while (outLen < maxLen) {
+		size_t inLen = 0;
+		if (!_plainDone) {
+			uint8_t *in = _deflater->inputBuffer(inLen);
+			if (inLen) {
+				inLen = _callback(in, inLen, _chunkOfs);
+				if (inLen) {
+					_deflater->commitInput(inLen);
+					_chunkOfs+= inLen;
+				} else _plainDone = true;
+			}
+		}
+		size_t outPart = _deflater->deflate(buf + outLen, maxLen - outLen, _plainDone);
+		outLen+= outPart;
+		if (_deflater->finished()) {
+			delete _deflater;
+			_deflater = nullptr;
+			_contentLength = 0; // Same as the plain termination below
+			break;
+		}
+		// Out of room, or window full until more output is taken
+		if (!inLen && !outPart) break;
+	}
+	return outLen;
+}
+
+#endif
+
+#define CHUNKBUF_MAXSIZE 0x2000
+
+static uint8_t hexDigits(size_t val) {
+	uint8_t digits = 1;
+	while (val >>= 4) digits++;
+	return digits;
+}
+
 void AsyncChunkedResponse::_prepareContentSendBuf(size_t space) {
+	if (!_contentLength) {
+		AsyncSimpleResponse::_prepareContentSendBuf(space);
+		return;
+	}
+	if (!_request->version()) {
+		// Unsized fallback, content goes out as is
+		AsyncBufferedResponse::_prepareContentSendBuf(space);
+		return;
+	}
+
 	// Make sure the buffer we are going to prepare is reasonable
 	if (space <= 32) return; // Too small to worth the effort
-	if (space > 0x2000) space = 0x2000; // Too big to work with (don't want to starve others!)
-
-	AsyncBufferedResponse::_prepareContentSendBuf(space);
+	if (space > CHUNKBUF_MAXSIZE) space = CHUNKBUF_MAXSIZE; // Too big to work with (don't want to starve others!)
+
+	if (!_stashbuf) {
+		// Let the chunk grow to the send window, fall back to regular staging size
+		_stashSize = space;
+		_stashbuf = (uint8_t*)malloc(_stashSize);
+		if (!_stashbuf && _stashSize > STAGEBUF_SIZE)
+			_stashbuf = (uint8_t*)malloc(_stashSize = STAGEBUF_SIZE);
+		if (!_stashbuf) {
+			ESPWS_DEBUGV("[%s] Buffer allocation failed!\n",
+				_request->_remoteIdent.c_str());
+			return;
+		}
+	}
+	if (space > _stashSize) space = _stashSize;
+
+	// Payload is placed after the longest possible size line, and the actual
+	// (minimal length) size line is written right before it afterwards.
+	// The tail leaves room for the payload CRLF and the last chunk.
+	uint8_t *buf = (uint8_t*)_stashbuf + hexDigits(space) + 2;
+	size_t chunkLen = _fillBuffer(buf, space - (buf - _stashbuf) - 7);
+	if (_failed()) return;
+	ESPWS_DEBUGV("[%s] Chunk #%d, %d bytes\n",
+		_request->_remoteIdent.c_str(), ++_chunkCnt, chunkLen);
+
+	uint8_t *start = buf;
+	size_t end = chunkLen;
+	if (chunkLen) {
+		uint8_t digits = hexDigits(chunkLen);
+		start -= digits + 2;
+		for (size_t i = digits, val = chunkLen; i--; val >>= 4)
+			start[i] = HexLookup_UC[val & 0xF];
+		start[digits] = '\r';
+		start[digits+1] = '\n';
+		buf[end++] = '\r';
+		buf[end++] = '\n';
+	}
+	// The last chunk goes out with the remaining payload
+	if (!_contentLength) {
+		memcpy(buf + end, "0\r\n\r\n", 5);
+		end += 5;
+	}
+	_sendbuf = start;
+	_bufLen = buf + end - start;
+	_bufPrepared+= _bufLen;
 }
 
 size_t AsyncChunkedResponse::_fillBuffer(uint8_t *buf, size_t maxLen){
-	size_t chunkOfs = _bufPrepared-(8*_chunkCnt++);
-	ESPWS_DEBUGV("[%s] Filling chunk #%d...\n",
-		_request->_remoteIdent.c_str(), _chunkCnt);
-	size_t chunkLen = _callback(buf+6, maxLen-8, chunkOfs);
-	// Encapsulate chunk
-	buf[0] = HexLookup_UC[(chunkLen >> 12) & 0xF];
-	buf[1] = HexLookup_UC[(chunkLen >> 8) & 0xF];
-	buf[2] = HexLookup_UC[(chunkLen >> 4) & 0xF];
-	buf[3] = HexLookup_UC[(chunkLen >> 0) & 0xF];
-	buf[4] = '\r';
-	buf[5] = '\n';
-	buf[6+chunkLen] = '\r';
-	buf[6+chunkLen+1] = '\n';
-	// Check for termination signal
-	if (!chunkLen) {
-		_contentLength = 0; // Stops fillBuffer from being called again
-		_state = RESPONSE_WAIT_ACK;
+#ifdef RESPONSE_COMPRESSION
+	if (_deflater) return _fillCompressed(buf, maxLen);
+#endif
+	size_t outLen = 0;
+	while (outLen < maxLen) {
+		size_t fillLen = _callback(buf + outLen, maxLen - outLen, _chunkOfs + outLen);
+		// Check for termination signal
+		if (!fillLen) {
+			// Stops fillBuffer from being called again, and lets the send buffer
+			// release move on to waiting for ack once the last chunk is out
+			_contentLength = 0;
+			break;
+		}
+		outLen+= fillLen;
+	}
+	_chunkOfs+= outLen;
+	return outLen;
+}
+
+/*
+ * Ring Buffer Print
+ * */
+
+RingBufferPrint::RingBufferPrint(size_t size)
+	: _buf((uint8_t*)malloc(size))
+	, _size(_buf? size : 0)
+{}
+
+size_t RingBufferPrint::read(uint8_t *buf, size_t len) {
+	if (len > _len) len = _len;
+	size_t tailLen = _size - _head;
+	if (len <= tailLen) {
+		memcpy(buf, _buf + _head, len);
+	} else {
+		memcpy(buf, _buf + _head, tailLen);
+		memcpy(buf + tailLen, _buf, len - tailLen);
+	}
+	_head = (_head + len) % (_size? _size : 1);
+	_len-= len;
+	return len;
+}
+
+size_t RingBufferPrint::write(uint8_t const *data, size_t len) {
+	if (len > space()) {
+		setWriteError();
+		return 0;
+	}
+	size_t tail = (_head + _len) % (_size? _size : 1);
+	size_t tailLen = _size - tail;
+	if (len <= tailLen) {
+		memcpy(_buf + tail, data, len);
+	} else {
+		memcpy(_buf + tail, data, tailLen);
+		memcpy(_buf, data + tailLen, len - tailLen);
+	}
+	_len+= len;
+	return len;
+}
+
+/*
+ * Ring Buffered Chunked Response
+ * */
+
+AsyncRingChunkedResponse::AsyncRingChunkedResponse(int code, String const &contentType,
+	size_t bufSize, size_t pieceMax)
+	: AsyncChunkedResponse(code, [this](uint8_t* buf, size_t len, size_t offset) -> size_t {
+			return _fillRing(buf, len);
+		}, contentType)
+	, _pieceMax(pieceMax)
+	, _ring(bufSize)
+	, _done(false)
+{
+	_plainFallback = true;
+}
+
+void AsyncRingChunkedResponse::_assembleHead(void) {
+	if (!_ring.capacity()) {
+		ESPWS_LOG("[%s] ERROR: Unable to allocate content buffer\n",
+			_request->_remoteIdent.c_str());
+		_code = 500;
+		_contentLength = 0; // Prevents fillBuffer from being called
+		_contentType.clear(true);
+		AsyncBasicResponse::_assembleHead();
+		return;
+	}
+	AsyncChunkedResponse::_assembleHead();
+}
+
+size_t AsyncRingChunkedResponse::_fillRing(uint8_t *buf, size_t len) {
+	size_t outLen = _ring.read(buf, len);
+	while (outLen < len && !_done) {
+		while (!_done && _ring.space() >= _pieceMax) {
+			_printPiece();
+			if (_ring.getWriteError()) {
+				// Content is already partly out, dropping the connection is
+				//   the only way left to tell the client it is incomplete
+				ESPWS_LOG("[%s] ERROR: Content piece overflowed, aborting response\n",
+					_request->_remoteIdent.c_str());
+				_state = RESPONSE_FAILED;
+				return 0;
+			}
+		}
+		outLen+= _ring.read(buf + outLen, len - outLen);
+	}
+	return outLen;
+}
+
+/*
+ * Directory Listing Response
+ * */
+
+#define DIRLIST_BUFSIZE   1024
+#define DIRLIST_ROWMAX    640
+#define DIRLIST_SKIPBATCH 16
+
+AsyncDirListResponse::AsyncDirListResponse(Dir const &dir, DirListFormat format, bool hasParent,
+	size_t cursor, size_t limit)
+	: AsyncRingChunkedResponse(200, format == DIRLIST_JSON? FC("application/json") : FC("text/html"),
+		DIRLIST_BUFSIZE, DIRLIST_ROWMAX)
+	, _dir(dir)
+	, _format(format)
+	, _hasParent(hasParent)
+	, _stage(DIRLIST_PREAMBLE)
+	, _entryCnt(0)
+	, _cursor(cursor)
+	, _skip(cursor)
+	, _limit(limit)
+	, _startTS(millis())
+	, _urlOfs(0)
+{
+	_dir.next(true);
+}
+
+size_t AsyncDirListResponse::_process(size_t resShare) {
+	// Dir has no seek, resuming from a cursor means walking past entries;
+	//   a batch per scheduler tick, before anything is sent
+	if (_skip) {
+		for (uint8_t i = DIRLIST_SKIPBATCH; _skip && i--; _skip--) {
+			if (!_dir.entryName()) {
+				_skip = 0;
+				break;
+			}
+			_dir.next();
+		}
+		return 0;
+	}
+	return AsyncRingChunkedResponse::_process(resShare);
+}
+
+// Prints the request URL from where the last slice stopped, true once complete
+bool AsyncDirListResponse::_printURLSlice(size_t budget) {
+	String const &url = _request->url();
+	while (_urlOfs < url.length() && budget >= 6) {
+		char c = url[_urlOfs++];
+		budget-= (_format == DIRLIST_JSON)? _printJSONChar(c) : _ring.print(c);
+	}
+	if (_urlOfs < url.length()) return false;
+	_urlOfs = 0;
+	return true;
+}
+
+void AsyncDirListResponse::_printPiece(void) {
+	switch (_stage) {
+		case DIRLIST_PREAMBLE:
+			if (_format == DIRLIST_JSON) {
+				_ring.print(FC("{\"path\":\""));
+			} else {
+				_ring.print(FC("<!DOCTYPE html><html><head><title>Directory content of '"));
+			}
+			_stage = DIRLIST_TITLE;
+			break;
+
+		case DIRLIST_TITLE:
+			if (_format == DIRLIST_JSON) {
+				// Leave room for the closing
+				if (!_printURLSlice(_pieceMax - 16)) break;
+				_ring.print(FC("\",\"entries\":["));
+				_stage = DIRLIST_ENTRIES;
+				break;
+			}
+			if (_printURLSlice(_pieceMax)) _stage = DIRLIST_HEAD;
+			break;
+
+		case DIRLIST_HEAD:
+			_ring.print(FC("'</title><style>table{width:100%;border-collapse:collapse}"
+				"th{background:#DDD;text-align:right}th:first-child{text-align:left}"
+				"td{text-align:right}td:first-child{text-align:left}"
+				".footnote{font-size:small}.left{float:left}.right{float:right}</style></head>"
+				"<body><h1>Directory '"));
+			_stage = DIRLIST_HEADING;
+			break;
+
+		case DIRLIST_HEADING:
+			if (_printURLSlice(_pieceMax)) _stage = DIRLIST_HEADER;
+			break;
+
+		case DIRLIST_HEADER:
+			_ring.print(FC("'</h1><hr><table><thead>"
+				"<tr><th>Name</th><th>Content</th><th>Modification Time</th></tr>"
+				"</thead><tbody>"));
+			if (_hasParent)
+				_ring.print(FC("<tr><td><a href='..'>(Parent folder)</a></td><td></td><td></td></tr>"));
+			_stage = DIRLIST_ENTRIES;
+			break;
+
+		case DIRLIST_ENTRIES:
+			if (_dir.entryName() && (!_limit || _entryCnt < _limit)) {
+				if (_format == DIRLIST_JSON) _printEntryJSON();
+				else _printEntryHTML();
+				_entryCnt++;
+				_dir.next();
+				break;
+			}
+			if (_format == DIRLIST_JSON) {
+				_ring.print(']');
+				if (_dir.entryName()) {
+					// Page limit reached, more to come
+					_ring.print(FC(",\"next\":\""));
+					_ring.print(_cursor + _entryCnt);
+					_ring.print('"');
+				}
+				_ring.print('}');
+			} else {
+				_ring.print(FC("</tbody></table><hr><div class='footnote'>"
+					"<span class='left'>Served by "));
+				_ring.print(FPSTR(AsyncWebServer::VERTOKEN));
+				_ring.print(FC(" ("));
+				_ring.print(GetPlatformSignature());
+				_ring.print(FC(")</span><span class='right'>Generated in "));
+				_ring.print(millis() - _startTS);
+				_ring.print(FC("ms</span></div></body></html>"));
+			}
+			_dir = Dir();
+			_done = true;
+			break;
+	}
+}
+
+void AsyncDirListResponse::_printEntryHTML(void) {
+	bool isDir = _dir.isEntryDir();
+	for (int i = 0; i < 2; i++) {
+		_ring.print(i? FC("'>") : FC("<tr><td><a href='"));
+		_ring.print(_dir.entryName());
+		if (isDir) _ring.print('/');
+	}
+	_ring.print(FC("</a></td><td>"));
+	if (!isDir) {
+		_ring.print(ToString(_dir.entrySize(), SizeUnit::BYTE, true));
+	} else if (_format == DIRLIST_HTML_LAZY) {
+		_ring.print(FC("&lt;folder&gt;"));
+	} else {
+		// Feed the dog before it bites
+		ESP.wdtFeed();
+		_ring.print(FC("&lt;"));
+		Dir _subdir = _dir.openEntryDir();
+		if (_subdir) {
+			size_t file_count = 0, dir_count = 0;
+			while (_subdir.next()) {
+				if (_subdir.isEntryDir()) ++dir_count;
+				else ++file_count;
+			}
+			if (file_count+dir_count) {
+				if (file_count) {
+					_ring.print(file_count);
+					_ring.print(FC(" file"));
+					if (file_count>1) _ring.print('s');
+				}
+				if (dir_count) {
+					if (file_count) _ring.print(FC(", "));
+					_ring.print(dir_count);
+					_ring.print(FC(" folder"));
+					if (dir_count>1) _ring.print('s');
+				}
+			} else {
+				_ring.print(FC("empty"));
+			}
+		} else {
+			_ring.print(FC("inaccessible"));
+		}
+		_ring.print(FC("&gt;"));
+	}
+	_ring.print(FC("</td><td>"));
+	time_t mtime = _dir.entryMtime();
+	char strbuf[30];
+	_ring.print(ctime_r(&mtime, strbuf));
+	_ring.print(FC("</td></tr>"));
+}
+
+void AsyncDirListResponse::_printEntryJSON(void) {
+	if (_entryCnt) _ring.print(',');
+	_ring.print(FC("{\"name\":"));
+	_printJSONString(_dir.entryName().c_str());
+	if (_dir.isEntryDir()) {
+		_ring.print(FC(",\"dir\":true"));
+	} else {
+		_ring.print(FC(",\"size\":"));
+		_ring.print(_dir.entrySize());
+	}
+	_ring.print(FC(",\"mtime\":"));
+	_ring.print((unsigned long)_dir.entryMtime());
+	_ring.print('}');
+}
+
+void AsyncDirListResponse::_printJSONString(char const *str) {
+	_ring.print('"');
+	while (*str) _printJSONChar(*str++);
+	_ring.print('"');
+}
+
+size_t AsyncDirListResponse::_printJSONChar(char c) {
+	if (c == '"' || c == '\\') {
+		_ring.print('\\');
+		_ring.print(c);
+		return 2;
+	}
+	if ((uint8_t)c < 0x20) {
+		_ring.print(FC("\\u00"));
+		_ring.print(HexLookup_UC[(c >> 4) & 0xF]);
+		_ring.print(HexLookup_UC[c & 0xF]);
+		return 6;
+	}
+	_ring.print(c);
+	return 1;
+}
+
+/*
+ * Deferred Response
+ * */
+
+void AsyncDeferredResponse::_respond(AsyncWebRequest &request) {
+	if (_state == RESPONSE_SETUP) {
+		// Appear to be sending, so that the scheduler keeps calling _process()
+		_request = &request;
+		_state = RESPONSE_HEADERS;
+	} else {
+		ESPWS_DEBUG("[%s] Unexpected response state: %s\n",
+			request._remoteIdent.c_str(), SFPSTR(_stateToString()));
+		_state = RESPONSE_FAILED;
+	}
+}
+
+size_t AsyncDeferredResponse::_process(size_t resShare) {
+	if (!_pending) return AsyncSimpleResponse::_process(resShare);
+
+	int code = _step();
+	if (code) {
+		ESPWS_DEBUGV("[%s] Deferred task complete: %d\n", _request->_remoteIdent.c_str(), code);
+		_pending = false;
+		_code = code;
+		_state = RESPONSE_SETUP;
+		AsyncSimpleResponse::_respond(*_request);
+	}
+	return 0;
+}
+
+#ifdef HANDLE_WEBDAV
+
+/*
+ * WebDAV PROPFIND Response
+ * */
+
+#define PROPFIND_BUFSIZE 2048
+#define PROPFIND_ROWMAX  1536
+
+AsyncPropFindResponse::AsyncPropFindResponse(Dir const &dir, bool isDir, size_t size, time_t mtime)
+	: AsyncRingChunkedResponse(207, FC("application/xml; charset=utf-8"),
+		PROPFIND_BUFSIZE, PROPFIND_ROWMAX)
+	, _dir(dir)
+	, _isDir(isDir)
+	, _size(size)
+	, _mtime(mtime)
+	, _stage(PROPFIND_SELF)
+{
+	if (_dir) _dir.next(true);
+}
+
+void AsyncPropFindResponse::_printPiece(void) {
+	switch (_stage) {
+		case PROPFIND_SELF:
+			_ring.print(FC("<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+				"<D:multistatus xmlns:D=\"DAV:\">"));
+			_printResponse(nullptr, _isDir, _size, _mtime);
+			_stage = PROPFIND_CHILDREN;
+			break;
+
+		case PROPFIND_CHILDREN:
+			if (_dir && _dir.entryName()) {
+				bool isDir = _dir.isEntryDir();
+				_printResponse(_dir.entryName().c_str(), isDir,
+					isDir? 0 : _dir.entrySize(), _dir.entryMtime());
+				_dir.next();
+				break;
+			}
+			_ring.print(FC("</D:multistatus>"));
+			_dir = Dir();
+			_done = true;
+			break;
+	}
+}
+
+void AsyncPropFindResponse::_printResponse(char const *name, bool isDir, size_t size, time_t mtime) {
+	String const &url = _request->url();
+	_ring.print(FC("<D:response><D:href>"));
+	_printHrefPart(url.c_str());
+	if ((name || isDir) && url.end()[-1] != '/') _ring.print('/');
+	if (name) {
+		_printHrefPart(name);
+		if (isDir) _ring.print('/');
+	}
+	_ring.print(FC("</D:href><D:propstat><D:prop>"));
+	if (isDir) {
+		_ring.print(FC("<D:resourcetype><D:collection/></D:resourcetype>"));
+	} else {
+		_ring.print(FC("<D:resourcetype/><D:getcontentlength>"));
+		_ring.print(size);
+		_ring.print(FC("</D:getcontentlength>"));
+		PGM_P Type = AsyncFileResponse::contentTypeByName(name? name : url.c_str());
+		if (Type) {
+			_ring.print(FC("<D:getcontenttype>"));
+			_ring.print(FPSTR(Type));
+			_ring.print(FC("</D:getcontenttype>"));
+		}
+		char ETag[24];
+		printFileETag(size, mtime, ETag, sizeof(ETag));
+		_ring.print(FC("<D:getetag>"));
+		_ring.print(ETag);
+		_ring.print(FC("</D:getetag>"));
+	}
+	char DateBuf[32];
+	if (mtime && printHTTPDate(mtime, DateBuf, sizeof(DateBuf))) {
+		_ring.print(FC("<D:getlastmodified>"));
+		_ring.print(DateBuf);
+		_ring.print(FC("</D:getlastmodified>"));
+	}
+	_ring.print(FC("</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>"));
+}
+
+void AsyncPropFindResponse::_printHrefPart(char const *str) {
+	// Percent-encode everything but unreserved characters and path separators,
+	//   which also takes care of XML special characters
+	while (*str) {
+		char c = *str++;
+		if (isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~') {
+			_ring.print(c);
+		} else {
+			_ring.print('%');
+			_ring.print(HexLookup_UC[(c >> 4) & 0xF]);
+			_ring.print(HexLookup_UC[c & 0xF]);
+		}
 	}
-	return chunkLen+8;
 }
+
+/*
+ * File Copy Response
+ * */
+
+AsyncFileCopyResponse::AsyncFileCopyResponse(Dir const &dir, String const &srcPath,
+	String const &dstPath, bool move, bool replace, std::function<void(void)> const &onDone)
+	: _dir(dir)
+	, _srcPath(srcPath)
+	, _dstPath(dstPath)
+	, _tmpPath(dstPath)
+	, _move(move)
+	, _replace(replace)
+	, _onDone(onDone)
+	, _buf(nullptr)
+{
+	_tmpPath.concat(FC("._copy_"));
+}
+
+AsyncFileCopyResponse::~AsyncFileCopyResponse() {
+	free(_buf);
+	if (_tmp) {
+		// Incomplete copy (failed, or the client went away)
+		_tmp.close();
+		_dir.remove(_tmpPath);
+	}
+}
+
+int AsyncFileCopyResponse::_step(void) {
+	if (!_buf) {
+		_src = _dir.openFile(_srcPath.c_str(), "r");
+		if (!_src) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to open copy source '%s'\n",
+				_request->_remoteIdent.c_str(), _srcPath.c_str());
+			return 500;
+		}
+		_tmp = _dir.openFile(_tmpPath.c_str(), "w");
+		if (!_tmp) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to create copy file '%s'\n",
+				_request->_remoteIdent.c_str(), _tmpPath.c_str());
+			return 500;
+		}
+		_buf = (uint8_t*)malloc(STATIC_DAV_COPYBUF);
+		if (!_buf) {
+			ESPWS_DEBUG("[%s] WARNING: Unable to allocate copy buffer\n",
+				_request->_remoteIdent.c_str());
+			return 500;
+		}
+		ESPWS_DEBUGV("[%s] Copy '%s' -> '%s' (%d bytes)\n", _request->_remoteIdent.c_str(),
+			_srcPath.c_str(), _dstPath.c_str(), _src.size());
+		return 0;
+	}
+
+	// Copy for a bounded time slice, then yield to other requests
+	uint32_t startTS = millis();
+	do {
+		size_t inLen = _src.read(_buf, STATIC_DAV_COPYBUF);
+		if (!inLen) return _finish();
+		uint8_t const *data = _buf;
+		while (inLen) {
+			size_t outLen = _tmp.write(data, inLen);
+			if (!outLen) {
+				ESPWS_DEBUG("[%s] WARNING: Copy file write failed!\n",
+					_request->_remoteIdent.c_str());
+				return 507;
+			}
+			data+= outLen;
+			inLen-= outLen;
+		}
+	} while (millis() - startTS < STATIC_DAV_COPYSLICE);
+	return 0;
+}
+
+int AsyncFileCopyResponse::_finish(void) {
+	int Ret = _replace? 204 : 201;
+	if (_replace && !_dir.remove(_dstPath)) {
+		ESPWS_DEBUG("[%s] WARNING: Unable to remove destination '%s'\n",
+			_request->_remoteIdent.c_str(), _dstPath.c_str());
+		Ret = 500;
+	} else if (!_tmp.rename(pathGetEntryName(_dstPath))) {
+		ESPWS_DEBUG("[%s] WARNING: Copy file rename failed '%s' -> '%s'\n",
+			_request->_remoteIdent.c_str(), _tmpPath.c_str(), _dstPath.c_str());
+		Ret = 500;
+	} else {
+		_tmp.close();
+		if (_move) {
+			_src.close();
+			if (!_dir.remove(_srcPath)) {
+				ESPWS_DEBUG("[%s] WARNING: Unable to remove moved source '%s'\n",
+					_request->_remoteIdent.c_str(), _srcPath.c_str());
+			}
+		}
+	}
+	if (_onDone) _onDone();
+	return Ret;
+}
+
+#endif
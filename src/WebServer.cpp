@@ -249,7 +249,7 @@ String AsyncWebServer::mapMethods(WebRequestMethodComposite methods) {
 	String Ret;
 	WebRequestMethod pivot = (WebRequestMethod)1;
 	while (methods) {
-		if (methods && pivot) {
+		if (methods & pivot) {
 			if (Ret) Ret.concat(',');
 			Ret.concat(FPSTR(mapMethod(pivot)));
 			methods&= ~pivot;
@@ -429,6 +429,14 @@ AsyncStaticWebHandler& AsyncWebServer::serveStatic(String const &uri, Dir const&
 	return addHandler(handler), *handler;
 }
 
+AsyncPackWebHandler& AsyncWebServer::servePack(String const &uri, PGM_VOID_P pack,
+	String const &indexFile, String const &cache_control) {
+	AsyncPackWebHandler* handler = new AsyncPackWebHandler(uri, pack);
+	if (cache_control) handler->setCacheControl(cache_control);
+	if (indexFile) handler->setIndexFile(indexFile);
+	return addHandler(handler), *handler;
+}
+
 void AsyncWebServer::_rewriteRequest(AsyncWebRequest &request) const {
 	for (const auto& r: _rewrites) {
 		if (r->_filter(request)) r->_perform(request);
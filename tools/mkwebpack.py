@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""
+Packs a directory of static web assets into a single read-only PROGMEM blob,
+served by AsyncPackWebHandler (see WebHandlerImpl.h for the layout).
+
+Files named "<asset>.gz" / "<asset>.br" next to "<asset>" are packed as its
+pre-encoded variants; without a sibling, they are packed as plain files under
+their own name. With --gzip, a gzip variant is
+generated for compressible assets that do not already have one, and the plain
+copy is dropped when --gzip-only.
+
+Usage: mkwebpack.py [--gzip] [--gzip-only] [--name WEBPACK] <dir> <output.h>
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import struct
+
+MAGIC = 0x4B505357
+ENCODINGS = {'': 0, '.gz': 1, '.br': 2}
+ENCODING_NAMES = {1: 'gzip', 2: 'br'}
+
+# Keep in sync with AsyncFileResponse::contentTypeByName()
+CONTENT_TYPES = {
+	'htm': 'text/html', 'html': 'text/html', 'css': 'text/css',
+	'json': 'application/json', 'js': 'text/javascript',
+	'png': 'image/png', 'gif': 'image/gif', 'jpg': 'image/jpeg', 'jpeg': 'image/jpeg',
+	'ico': 'image/x-icon', 'svg': 'image/svg+xml', 'eot': 'font/eot',
+	'woff': 'font/woff', 'woff2': 'font/woff2', 'ttf': 'font/ttf',
+	'xml': 'text/xml', 'txt': 'text/plain', 'xhtml': 'application/xhtml+xml',
+	'pdf': 'application/pdf', 'zip': 'application/zip', 'gz': 'application/x-gzip',
+	'mjs': 'text/javascript', 'map': 'application/json', 'wasm': 'application/wasm',
+	'webp': 'image/webp', 'avif': 'image/avif',
+}
+COMPRESSIBLE = ('text/', 'application/json', 'application/xhtml+xml', 'image/svg+xml')
+
+
+def fnv1a(data):
+	h = 2166136261
+	for b in data:
+		h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+	return h
+
+
+def align4(buf):
+	buf.extend(b'\0' * (-len(buf) % 4))
+
+
+def collect(root, gen_gzip, gzip_only):
+	assets = {}
+	for base, _, files in os.walk(root):
+		for fn in files:
+			full = os.path.join(base, fn)
+			name = os.path.relpath(full, root).replace(os.sep, '/')
+			with open(full, 'rb') as f:
+				assets[name] = f.read()
+
+	entries = []
+	for name in sorted(assets):
+		ext = os.path.splitext(name)[1]
+		asset = name
+		if ext in ('.gz', '.br') and name[:-3] in assets:
+			asset = name[:-3]
+		else:
+			ext = ''
+		entries.append([name, asset, ENCODINGS[ext], assets[name]])
+
+	if gen_gzip:
+		for name, asset, enc, body in list(entries):
+			ctype = content_type(asset)
+			if enc or (name + '.gz') in assets or not ctype.startswith(COMPRESSIBLE):
+				continue
+			packed = gzip.compress(body, 9, mtime=0)
+			if len(packed) >= len(body):
+				continue
+			entries.append([name + '.gz', asset, 1, packed])
+			if gzip_only:
+				entries.remove([name, asset, enc, body])
+	return entries
+
+
+def content_type(name):
+	return CONTENT_TYPES.get(name.rsplit('.', 1)[-1].lower(), 'application/octet-stream')
+
+
+def build(entries):
+	# Entry count and the (power of two) bucket count are stored as uint16
+	if len(entries) > 0x8000:
+		raise SystemExit('too many entries (%d), at most 32768 fit in a pack' % len(entries))
+
+	variants = {}
+	for name, asset, enc, body in entries:
+		variants.setdefault(asset, set()).add(enc)
+
+	bucket_count = 1
+	while bucket_count < len(entries):
+		bucket_count <<= 1
+	records = sorted(((fnv1a(e[0].encode()), e) for e in entries),
+		key=lambda r: (r[0] & (bucket_count - 1), r[1][0]))
+
+	head = bytearray(struct.pack('<IHH', MAGIC, len(records), bucket_count))
+	starts = [0] * (bucket_count + 1)
+	for h, _ in records:
+		starts[(h & (bucket_count - 1)) + 1] += 1
+	for i in range(bucket_count):
+		starts[i + 1] += starts[i]
+	head += struct.pack('<%dH' % len(starts), *starts)
+	align4(head)
+
+	entry_size = 7 * 4
+	data_base = len(head) + entry_size * len(records)
+	data = bytearray()
+	table = bytearray()
+	for h, (name, asset, enc, body) in records:
+		etag = '"%s"' % hashlib.md5(body).hexdigest()[:16]
+		lines = ['Content-Type: ' + content_type(asset), 'ETag: ' + etag]
+		if enc:
+			lines.append('Content-Encoding: ' + ENCODING_NAMES[enc])
+		# Same rule as the 304 path of AsyncPackWebHandler: any encoded variant
+		# makes the response depend on Accept-Encoding (even if 404 for some)
+		if variants[asset] - {0}:
+			lines.append('Vary: Accept-Encoding')
+		strings = []
+		for s in (name, etag, ''.join(l + '\r\n' for l in lines)):
+			strings.append(data_base + len(data))
+			data += s.encode() + b'\0'
+		align4(data)
+		body_ofs = data_base + len(data)
+		data += body
+		align4(data)
+		table += struct.pack('<7I', h, strings[0], strings[1], strings[2],
+			body_ofs, len(body), enc)
+	return bytes(head + table + data)
+
+
+def emit(blob, symbol, out):
+	with open(out, 'w') as f:
+		f.write('// Generated by mkwebpack.py, do not edit\n')
+		f.write('#pragma once\n\n')
+		f.write('static const uint8_t %s[] PROGMEM __attribute__((aligned(4))) = {\n' % symbol)
+		for i in range(0, len(blob), 16):
+			f.write('\t' + ', '.join('0x%02x' % b for b in blob[i:i + 16]) + ',\n')
+		f.write('};\n')
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.strip().split('\n')[0])
+	parser.add_argument('--gzip', action='store_true', help='generate gzip variants')
+	parser.add_argument('--gzip-only', action='store_true', help='drop plain copy of gzipped assets')
+	parser.add_argument('--name', default='WEBPACK', help='symbol name of the blob')
+	parser.add_argument('dir')
+	parser.add_argument('output')
+	args = parser.parse_args()
+
+	entries = collect(args.dir, args.gzip or args.gzip_only, args.gzip_only)
+	blob = build(entries)
+	emit(blob, args.name, args.output)
+	print('%d entries, %d bytes' % (len(entries), len(blob)))
+
+
+if __name__ == '__main__':
+	main()